@@ -0,0 +1,153 @@
+/*
+ * File: Airtime.hpp
+ *
+ * Description:
+ * This header file provides constexpr functions computing the time on air
+ * of a LoRaWAN uplink and the regional limits of the EU868 band, so that
+ * the configuration can be checked against them at compile time.
+ *
+ * The time on air follows the formula of the Semtech LoRa modem designer's
+ * guide (AN1200.13) with an 8 symbols preamble, explicit header, CRC on,
+ * coding rate 4/5 and low data rate optimisation for SF11 and SF12 at 125 kHz.
+ *
+ * Functions:
+ * - eu868SpreadingFactor: Spreading factor of an EU868 data rate.
+ * - eu868BandwidthHz: Bandwidth of an EU868 data rate.
+ * - eu868MaxPayload: Maximum application payload of an EU868 data rate.
+ * - loraSymbolTimeUs: Duration of a LoRa symbol.
+ * - loraPayloadSymbols: Number of symbols of the PHY payload.
+ * - loraAirtimeUs: Time on air of a LoRa frame.
+ * - eu868AirtimeUs: Time on air of a LoRaWAN uplink on an EU868 data rate.
+ * - eu868JoinAirtimeUs: Time on air of a LoRaWAN join request on an EU868 data rate.
+ * - eu868DutyCyclePpm: Duty cycle of a periodic uplink.
+ *
+ * Note:
+ * The Arduino SAMD core compiles with -std=gnu++11, so every function
+ * is a single return statement.
+ */
+
+#ifndef HPP__AIRTIME__HPP
+#define HPP__AIRTIME__HPP
+
+#include <stdint.h>
+
+// LoRaWAN overhead around the application payload: MHDR (1), DevAddr (4),
+// FCtrl (1), FCnt (2), FPort (1) and MIC (4), without FOpts.
+#define LORAWAN_FRAME_OVERHEAD 13
+
+// PHY payload of a join request: MHDR, JoinEUI, DevEUI, DevNonce and MIC
+#define LORAWAN_JOIN_REQUEST_SIZE 23
+
+// Duty cycle of the EU868 g1 sub-band (868.0 - 868.6 MHz) used by the
+// three default channels: 1 %, in parts per million.
+#define EU868_MAX_DUTY_CYCLE_PPM 10000
+
+/**
+ * @brief Returns the spreading factor of an EU868 data rate (DR0 = SF12 ... DR5 = SF7, DR6 = SF7).
+ */
+constexpr uint8_t eu868SpreadingFactor(uint8_t dataRate)
+{
+  return dataRate >= 5 ? 7 : 12 - dataRate;
+}
+
+/**
+ * @brief Returns the bandwidth of an EU868 data rate in Hz (250 kHz for DR6, 125 kHz otherwise).
+ */
+constexpr uint32_t eu868BandwidthHz(uint8_t dataRate)
+{
+  return dataRate == 6 ? 250000UL : 125000UL;
+}
+
+/**
+ * @brief Returns the maximum application payload size of an EU868 data rate.
+ *
+ * @param dataRate The EU868 data rate (0 to 7).
+ *
+ * @return The maximum FRMPayload size in bytes, assuming no FOpts.
+ */
+constexpr uint8_t eu868MaxPayload(uint8_t dataRate)
+{
+  return dataRate <= 2 ? 51 : (dataRate == 3 ? 115 : 222);
+}
+
+/**
+ * @brief Returns the duration of a LoRa symbol in microseconds.
+ */
+constexpr uint32_t loraSymbolTimeUs(uint8_t spreadingFactor, uint32_t bandwidthHz)
+{
+  return (uint32_t)(((uint64_t)1 << spreadingFactor) * 1000000ULL / bandwidthHz);
+}
+
+/**
+ * @brief Returns the number of symbols carrying a PHY payload of the given size.
+ *
+ * @param phyPayload The PHY payload size in bytes.
+ * @param spreadingFactor The spreading factor (7 to 12).
+ * @param lowDataRateOptimize true if the low data rate optimisation is enabled.
+ */
+constexpr uint32_t loraPayloadSymbols(uint16_t phyPayload, uint8_t spreadingFactor, bool lowDataRateOptimize)
+{
+  return 8 + ((int32_t)(8 * phyPayload) - 4 * spreadingFactor + 28 + 16 <= 0 ? 0 :
+    ((8 * phyPayload) - 4 * spreadingFactor + 28 + 16 + 4 * (spreadingFactor - (lowDataRateOptimize ? 2 : 0)) - 1)
+    / (4 * (spreadingFactor - (lowDataRateOptimize ? 2 : 0))) * 5);
+}
+
+/**
+ * @brief Returns the time on air of a LoRa frame in microseconds.
+ *
+ * @param phyPayload The PHY payload size in bytes.
+ * @param spreadingFactor The spreading factor (7 to 12).
+ * @param bandwidthHz The bandwidth in Hz.
+ */
+constexpr uint32_t loraAirtimeUs(uint16_t phyPayload, uint8_t spreadingFactor, uint32_t bandwidthHz)
+{
+  // Preamble of 8 + 4.25 symbols, i.e. 49 quarter symbols
+  return 49 * loraSymbolTimeUs(spreadingFactor, bandwidthHz) / 4
+    + loraPayloadSymbols(phyPayload, spreadingFactor, spreadingFactor >= 11 && bandwidthHz == 125000UL)
+    * loraSymbolTimeUs(spreadingFactor, bandwidthHz);
+}
+
+/**
+ * @brief Returns the time on air of a LoRaWAN uplink on an EU868 data rate in microseconds.
+ *
+ * @param appPayload The application payload (FRMPayload) size in bytes.
+ * @param dataRate The EU868 data rate (0 to 6).
+ */
+constexpr uint32_t eu868AirtimeUs(uint16_t appPayload, uint8_t dataRate)
+{
+  return loraAirtimeUs(appPayload + LORAWAN_FRAME_OVERHEAD, eu868SpreadingFactor(dataRate), eu868BandwidthHz(dataRate));
+}
+
+/**
+ * @brief Returns the time on air of a LoRaWAN join request on an EU868 data rate in microseconds.
+ *
+ * @param dataRate The EU868 data rate (0 to 6).
+ */
+constexpr uint32_t eu868JoinAirtimeUs(uint8_t dataRate)
+{
+  return loraAirtimeUs(LORAWAN_JOIN_REQUEST_SIZE, eu868SpreadingFactor(dataRate), eu868BandwidthHz(dataRate));
+}
+
+/**
+ * @brief Returns the duty cycle of a periodic uplink, rounded up.
+ *
+ * The duty cycles of several periodic uplinks add up, their sum must stay 
+ * below EU868_MAX_DUTY_CYCLE_PPM.
+ *
+ * @param appPayload The application payload size in bytes.
+ * @param dataRate The EU868 data rate (0 to 6).
+ * @param transmissions The number of transmissions of each uplink in the worst case.
+ * @param intervalMs The interval between two uplinks in milliseconds.
+ *
+ * @return The cumulated time on air over the interval, in parts per million.
+ */
+constexpr uint32_t eu868DutyCyclePpm(uint16_t appPayload, uint8_t dataRate, uint8_t transmissions, uint32_t intervalMs)
+{
+  return (uint32_t)(((uint64_t)eu868AirtimeUs(appPayload, dataRate) * transmissions * 1000ULL + intervalMs - 1) / intervalMs);
+}
+
+// Reference values of the Semtech LoRa calculator
+static_assert(eu868AirtimeUs(10, 5) == 61696, "SF7 airtime of a 10 bytes payload must be 61.7 ms");
+static_assert(eu868AirtimeUs(10, 0) == 1482752, "SF12 airtime of a 10 bytes payload must be 1482.8 ms");
+
+#endif
\ No newline at end of file
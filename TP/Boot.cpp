@@ -0,0 +1,127 @@
+/*
+ * File: Boot.cpp
+ *
+ * Description:
+ * This source file implements the boot sequencer of the node. The
+ * initialization steps are run as tasks of the scheduler:
+ * - the SHT31 sensor step, which only depends on the I2C bus,
+ * - the LoRa modem step, followed by the credentials check, which reads
+ *   the modem NVM in one pass, or not at all after a warm reset.
+ * The application task is registered once both steps have completed.
+ *
+ * Functions:
+ * - init_Boot: Registers the boot steps in the scheduler.
+ * - bootCompleted: Indicates whether every boot step has completed.
+ */
+
+#include "Boot.hpp"
+#include "Driver_SHT31.hpp"
+#include "Driver_LoRaWan.hpp"
+#include "Driver_Credentials.hpp"
+#include "Profiler.hpp"
+
+// Application task started at the end of the boot, and its period.
+static TaskFunction applicationTask = NULL;
+static unsigned long applicationPeriodMs = 0;
+
+// Completion state of the boot steps.
+static bool sensorReady = false;
+static bool modemReady = false;
+
+/**
+ * @brief Starts the application task once every boot step has completed.
+ */
+static void startApplication()
+{
+  if(bootCompleted())
+  {
+    addTask(applicationTask, 0, applicationPeriodMs);
+  }
+}
+
+/**
+ * @brief Boot step initializing the SHT31 sensor.
+ */
+static void bootSensor()
+{
+  profileStart(PHASE_SENSOR_BEGIN);
+  init_SHT31();
+  profileEnd(PHASE_SENSOR_BEGIN);
+  sensorReady = true;
+  startApplication();
+}
+
+/**
+ * @brief Boot step initializing the LoRa modem and the credentials.
+ *
+ * If the credentials are not initialized yet, the NVM of the modem is set
+ * to its initial state and the credentials are requested on the console.
+ * A factory image (Config::FACTORY_CREDENTIALS) uses the credentials
+ * written in it instead, if they are valid, and locks their flash region.
+ */
+static void bootModem()
+{
+  profileStart(PHASE_MODEM_BEGIN);
+  init_LoRaWan();
+  profileEnd(PHASE_MODEM_BEGIN);
+
+  // Check if the credentials are already initialized, the credentials of a
+  // factory image skip the NVM and the console
+  profileStart(PHASE_NVM_READ);
+  bool factory = Config::FACTORY_CREDENTIALS && loadFactoryCredentials();
+  if(Config::FACTORY_CREDENTIALS && !factory)
+  {
+    console.println("Invalid factory credentials, falling back to the console");
+  }
+  if(factory && !lockFactoryCredentials())
+  {
+    console.println("Factory credentials share the flash region of the history, left unlocked");
+  }
+  bool init = factory || credentialsAlreadyInit();
+  profileEnd(PHASE_NVM_READ);
+
+  if(!init)
+  {
+    // Initialize the NVM to the initial state
+    profileStart(PHASE_NVM_INIT);
+    writeNVM(0,Config::MAGIC_NUMBER);
+    writeNVM(1,0);
+    writeNVM(2,Config::MAGIC_NUMBER);
+    profileEnd(PHASE_NVM_INIT);
+
+    // Initialize credentials with AT commands, then save them
+    profileStart(PHASE_CREDENTIALS);
+    init_Credentials();
+  }
+
+  modemReady = true;
+  startApplication();
+}
+
+/**
+ * @brief Registers the boot steps in the scheduler.
+ *
+ * The sensor step is registered first: it only takes a few milliseconds and
+ * lets the first measurement be ready when the modem is. 
+ *
+ * @param application The application task to start at the end of the boot.
+ * @param periodMs The period of the application task in milliseconds.
+ */
+void init_Boot(TaskFunction application, unsigned long periodMs)
+{
+  applicationTask = application;
+  applicationPeriodMs = periodMs;
+
+  addTask(bootSensor, 0, 0);
+  addTask(bootModem, 0, 0);
+}
+
+/**
+ * @brief Indicates whether every boot step has completed.
+ *
+ * @return true if the sensor and the modem are initialized.
+ */
+bool bootCompleted()
+{
+  return sensorReady && modemReady;
+}
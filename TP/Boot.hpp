@@ -0,0 +1,25 @@
+/*
+ * File: Boot.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the boot sequencer of the
+ * node. The initialization steps are run as tasks of the scheduler, so
+ * that the steps which do not depend on each other are not serialized
+ * behind the slow LoRa modem startup, and the application task is
+ * started as soon as every step has completed.
+ *
+ * Functions:
+ * - init_Boot: Registers the boot steps in the scheduler.
+ * - bootCompleted: Indicates whether every boot step has completed.
+ */
+
+#ifndef HPP__BOOT__HPP
+#define HPP__BOOT__HPP
+
+#include <Arduino.h>
+#include "Scheduler.hpp"
+
+void init_Boot(TaskFunction application, unsigned long periodMs);
+bool bootCompleted();
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * File: Channels.cpp
+ *
+ * Description:
+ * This source file implements the channel statistics and the preferred
+ * channel mask. Probe uplinks restricted to a single channel measure the
+ * success rate of each channel, the other uplinks avoid the channels
+ * which persistently fail.
+ *
+ * The configuration digest (see Health.hpp) is queued again each time the
+ * statistics change the preferred mask.
+ *
+ * Functions:
+ * - init_Channels: Enables every channel in the preferred mask.
+ * - resetChannelMask: Reads the channels enabled by the join, and forces the mask to be sent again.
+ * - channelBeforeUplink: Applies the mask of the next uplink.
+ * - channelAfterUplink: Records the outcome of the uplink.
+ * - channelSuccessRate: Returns the average success rate of a channel.
+ * - preferredChannelMask: Returns the preferred channel mask.
+ * - enabledChannelMask: Returns the mask of the channels defined by the network.
+ *
+ * Note:
+ * The 3 default EU868 channels and the 5 channels of the CFList of the
+ * join accept are in the g and g1 sub-bands, which both have a 1 % duty
+ * cycle: restricting the mask does not change the duty cycle budget
+ * checked in Config.hpp.
+ */
+
+#include <stdio.h>
+#include "Channels.hpp"
+#include "LinkQuality.hpp"
+#include "Driver_Credentials.hpp"
+#include "FixedPoint.hpp"
+#include "Health.hpp"
+
+// Statistics of the channels, the success rates start at 100 %.
+ChannelStats channelStats[Config::CHANNEL_COUNT];
+
+// Mask of the channels defined by the network, the only ones probed and used.
+static uint16_t enabledMask = EU868_DEFAULT_CHANNEL_MASK;
+
+// Mask of the channels used by the uplinks which are not probes.
+static uint16_t preferredMask = 0;
+
+// Mask currently applied to the modem, 0 if unknown.
+static uint16_t appliedMask = 0;
+
+// Channel probed by the current uplink, -1 if the uplink is not a probe.
+static int probeChannel = -1;
+
+// Next channel to probe, and number of uplinks since the last probe.
+static uint8_t nextProbe = 0;
+static unsigned int uplinksSinceProbe = 0;
+
+/**
+ * @brief Sends a channel mask to the modem, unless it is already applied.
+ *
+ * @param mask The mask of the channels 0 to 15.
+ *
+ * @return true if the mask is applied.
+ */
+static bool applyChannelMask(uint16_t mask)
+{
+  if (mask == appliedMask)
+  {
+    return true;
+  }
+
+  char command[sizeof(CHANNEL_MASK_COMMAND) + 24];
+  snprintf(command, sizeof(command), "%s%04x%020d", CHANNEL_MASK_COMMAND, mask, 0);
+  SerialLoRa.println(command);
+
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  if (readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) > 0 && strstr(response, "+OK") != NULL)
+  {
+    appliedMask = mask;
+    return true;
+  }
+  appliedMask = 0;
+  return false;
+}
+
+/**
+ * @brief Reads the channel mask of the modem.
+ *
+ * @return The mask of the channels 0 to Config::CHANNEL_COUNT - 1 enabled in
+ *         the modem, 0 if the modem did not answer.
+ */
+static uint16_t readChannelMask()
+{
+  SerialLoRa.println(CHANNEL_MASK_QUERY);
+
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  if (readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) == 0 || strncmp(response, "+OK=", 4) != 0)
+  {
+    return 0;
+  }
+
+  // The first 4 hexadecimal digits hold the mask of channels 0 to 15
+  char digits[5];
+  strncpy(digits, &response[4], 4);
+  digits[4] = '\0';
+  return (uint16_t)strtoul(digits, NULL, 16) & ((1UL << Config::CHANNEL_COUNT) - 1);
+}
+
+/**
+ * @brief Recomputes the preferred channel mask.
+ *
+ * The enabled channels are taken from the best success rate to the worst,
+ * all the channels above Config::CHANNEL_BAD_PERCENT and at least
+ * Config::MIN_ENABLED_CHANNELS channels, or every enabled channel if there
+ * are fewer.
+ *
+ * @return true if the preferred mask has changed.
+ */
+static bool updatePreferredMask()
+{
+  uint16_t mask = 0;
+  for (int enabled = 0; enabled < Config::CHANNEL_COUNT; enabled++)
+  {
+    int best = -1;
+    for (int i = 0; i < Config::CHANNEL_COUNT; i++)
+    {
+      if ((enabledMask & ~mask & (1 << i)) && (best < 0 || channelStats[i].successRate > channelStats[best].successRate))
+      {
+        best = i;
+      }
+    }
+    if (best < 0 || (enabled >= Config::MIN_ENABLED_CHANNELS && channelSuccessRate(best) < Config::CHANNEL_BAD_PERCENT))
+    {
+      break;
+    }
+    mask |= 1 << best;
+  }
+  bool changed = mask != preferredMask;
+  preferredMask = mask;
+  return changed;
+}
+
+/**
+ * @brief Enables every channel in the preferred mask.
+ */
+void init_Channels()
+{
+  for (int i = 0; i < Config::CHANNEL_COUNT; i++)
+  {
+    channelStats[i].probes = 0;
+    channelStats[i].successes = 0;
+    channelStats[i].successRate = 100 << 8;
+  }
+  enabledMask = EU868_DEFAULT_CHANNEL_MASK;
+  updatePreferredMask();
+  appliedMask = 0;
+}
+
+/**
+ * @brief Reads the channels enabled by the join, and forces the mask to be sent again.
+ *
+ * A join resets the channel plan of the modem to the default channels and
+ * those of the CFList of the join accept. Must be called right after the
+ * join, before any mask is applied: the mask of the modem is then the plan
+ * of the network. The default channels are kept if the modem does not
+ * answer. The preferred mask is sent again before the next uplink.
+ */
+void resetChannelMask()
+{
+  uint16_t mask = readChannelMask();
+  enabledMask = mask != 0 ? mask : EU868_DEFAULT_CHANNEL_MASK;
+  updatePreferredMask();
+  appliedMask = 0;
+}
+
+/**
+ * @brief Applies the mask of the next uplink.
+ *
+ * Every Config::CHANNEL_PROBE_PERIOD uplinks, the uplink is a probe
+ * restricted to the next enabled channel in turn. Otherwise the preferred
+ * mask is applied. Must be called before each uplink, followed by channelAfterUplink().
+ */
+void channelBeforeUplink()
+{
+  probeChannel = -1;
+  if (Config::CHANNEL_PROBE_PERIOD > 0 && ++uplinksSinceProbe >= Config::CHANNEL_PROBE_PERIOD)
+  {
+    uplinksSinceProbe = 0;
+    while (!(enabledMask & (1 << nextProbe)))
+    {
+      nextProbe = (nextProbe + 1) % Config::CHANNEL_COUNT;
+    }
+    if (applyChannelMask(1 << nextProbe))
+    {
+      probeChannel = nextProbe;
+    }
+    nextProbe = (nextProbe + 1) % Config::CHANNEL_COUNT;
+  }
+
+  if (probeChannel < 0)
+  {
+    applyChannelMask(preferredMask);
+  }
+}
+
+/**
+ * @brief Records the outcome of the uplink.
+ *
+ * The outcome of a probe updates the statistics of its channel and the
+ * preferred mask, which is restored by the next channelBeforeUplink().
+ * A new preferred mask queues the configuration digest again.
+ *
+ * @param success true if the uplink was acknowledged.
+ */
+void channelAfterUplink(bool success)
+{
+  if (probeChannel < 0)
+  {
+    return;
+  }
+
+  ChannelStats &stats = channelStats[probeChannel];
+  stats.probes ++;
+  if (success)
+  {
+    stats.successes ++;
+  }
+  stats.successRate = qEwma(stats.successRate, qFromInt(success ? 100 : 0, 8), LINK_EWMA_SHIFT);
+  probeChannel = -1;
+  if (updatePreferredMask())
+  {
+    queueConfigDigest();
+  }
+}
+
+/**
+ * @brief Returns the average success rate of a channel, in percent.
+ *
+ * @param channel The channel number.
+ */
+uint8_t channelSuccessRate(uint8_t channel)
+{
+  return qRound(channelStats[channel].successRate, 8);
+}
+
+/**
+ * @brief Returns the preferred channel mask.
+ */
+uint16_t preferredChannelMask()
+{
+  return preferredMask;
+}
+
+/**
+ * @brief Returns the mask of the channels defined by the network.
+ */
+uint16_t enabledChannelMask()
+{
+  return enabledMask;
+}
@@ -0,0 +1,68 @@
+/*
+ * File: Channels.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the channel statistics.
+ * The modem does not report the channel of an uplink, so the outcome of
+ * an uplink can only be attributed to a channel when it is the only one
+ * enabled. Every Config::CHANNEL_PROBE_PERIOD uplinks, a probe uplink is
+ * therefore restricted to one channel, taken in turn, and its outcome is
+ * averaged into the statistics of that channel.
+ *
+ * Only the channels defined by the network are measured and used: the 3
+ * default EU868 channels, and after a join the channels enabled in the
+ * modem, i.e. those of the CFList of the join accept or of an AT+CHANMASK
+ * command, read back from the modem with AT+CHANMASK?.
+ *
+ * The other uplinks use a preferred channel mask, which excludes the
+ * channels whose average success rate fell below
+ * Config::CHANNEL_BAD_PERCENT, while always keeping at least
+ * Config::MIN_ENABLED_CHANNELS channels so that the uplinks still hop
+ * between frequencies.
+ *
+ * Functions:
+ * - init_Channels: Enables every channel in the preferred mask.
+ * - resetChannelMask: Reads the channels enabled by the join, and forces the mask to be sent again.
+ * - channelBeforeUplink: Applies the mask of the next uplink.
+ * - channelAfterUplink: Records the outcome of the uplink.
+ * - channelSuccessRate: Returns the average success rate of a channel.
+ * - preferredChannelMask: Returns the preferred channel mask.
+ * - enabledChannelMask: Returns the mask of the channels defined by the network.
+ */
+
+#ifndef HPP__CHANNELS__HPP
+#define HPP__CHANNELS__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+// AT command of the modem firmware setting the channel mask, followed by
+// 24 hexadecimal digits, the first 4 holding the mask of channels 0 to 15.
+#define CHANNEL_MASK_COMMAND "AT+CHANMASK="
+
+// AT command reading the channel mask of the modem, answered by "+OK=" and
+// the mask in the same format.
+#define CHANNEL_MASK_QUERY "AT+CHANMASK?"
+
+// Mask of the 3 default EU868 channels, enabled before the join.
+#define EU868_DEFAULT_CHANNEL_MASK 0x0007
+
+// Statistics of a channel, the average success rate is in 1/256 %.
+struct ChannelStats
+{
+  uint16_t probes;
+  uint16_t successes;
+  uint16_t successRate;
+};
+
+extern ChannelStats channelStats[];
+
+void init_Channels();
+void resetChannelMask();
+void channelBeforeUplink();
+void channelAfterUplink(bool success);
+uint8_t channelSuccessRate(uint8_t channel);
+uint16_t preferredChannelMask();
+uint16_t enabledChannelMask();
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * File: Config.hpp
+ *
+ * Description:
+ * This header file gathers the compile-time configuration of the node.
+ * Every tunable value of the drivers and of the sketch (baud rates,
+ * LoRaWAN settings, sensor address, reporting interval, ...) is a
+ * constexpr member of a configuration type, so that the compiler folds
+ * the constants and drops the branches they disable.
+ *
+ * A site variant is declared below DefaultConfig as a type deriving from
+ * it and overriding the members that differ, then selected at build time:
+ *
+ *   struct FactoryFloorConfig : DefaultConfig
+ *   {
+ *     static constexpr uint8_t DATA_RATE = 3;
+ *     static constexpr unsigned long REPORT_INTERVAL_MS = 60000;
+ *   };
+ *
+ *   -DNODE_CONFIG=FactoryFloorConfig
+ *
+ * Invalid combinations of values are rejected by static_assert at the
+ * end of this file, including uplinks exceeding the maximum payload of
+ * the data rate or the EU868 duty cycle (see Airtime.hpp). The checks
+ * use the slowest data rate the link policy may select, MIN_DATA_RATE,
+ * and TX_TRANSMISSIONS, the number of times an uplink is transmitted in
+ * the worst case.
+ *
+ * Note:
+ * The Arduino SAMD core compiles with -std=gnu++11, so constexpr
+ * functions are limited to a single return statement.
+ */
+
+#ifndef HPP__CONFIG__HPP
+#define HPP__CONFIG__HPP
+
+#include <Arduino.h>
+#include "Airtime.hpp"
+
+/**
+ * @brief Default configuration of the node.
+ */
+struct DefaultConfig
+{
+  // Serial interfaces
+  static constexpr unsigned long CONSOLE_BAUDRATE = 115200;
+  static constexpr unsigned long MODEM_BAUDRATE = 19200;
+  static constexpr unsigned long MODEM_RESPONSE_TIMEOUT_MS = 1000;
+
+  // Credentials state stored in the modem NVM
+  static constexpr uint8_t MAGIC_NUMBER = 92;
+
+  // Factory provisioning: the credentials are read from a record of the
+  // firmware image, written per device by tools/factory_images.py, instead
+  // of being requested on the console (see Driver_Credentials.hpp).
+  static constexpr bool FACTORY_CREDENTIALS = false;
+
+  // LoRaWAN network
+  static constexpr unsigned long MIN_POLL_INTERVAL_S = 60;
+  static constexpr uint8_t DATA_RATE = 5;
+  static constexpr uint8_t MIN_DATA_RATE = 5;
+  static constexpr uint8_t TX_TRANSMISSIONS = 1;
+  static constexpr int MAX_TX_ERRORS = 50;
+  static constexpr unsigned long TX_ERROR_BACKOFF_MS = 1000;
+
+  // LoRa modem power management
+  static constexpr bool MODEM_POWER_SAVE = true;
+  static constexpr unsigned long MODEM_SLEEP_DELAY_MS = 500;
+  static constexpr int MODEM_WAKE_ATTEMPTS = 3;
+  static constexpr unsigned long MODEM_WAKE_TIMEOUT_MS = 100;
+
+  // Downlink reception: 'A' for class A only, 'C' for a permanent class C.
+  // In class A, a class C window of CLASS_C_WINDOW_DURATION_MS is opened
+  // every CLASS_C_WINDOW_PERIOD_MS (0 disables the periodic windows).
+  static constexpr char DEVICE_CLASS = 'A';
+  static constexpr unsigned long CLASS_C_WINDOW_PERIOD_MS = 0;
+  static constexpr unsigned long CLASS_C_WINDOW_DURATION_MS = 30000;
+  static constexpr unsigned long DOWNLINK_POLL_PERIOD_MS = 100;
+
+  // Link quality: a LinkCheckReq every LINK_CHECK_PERIOD uplinks (0 disables
+  // them), link lost and data rate policy thresholds (see LinkQuality.cpp).
+  static constexpr unsigned int LINK_CHECK_PERIOD = 10;
+  static constexpr uint8_t LINK_LOST_PERCENT = 10;
+  static constexpr uint8_t LINK_SLOWDOWN_PERCENT = 70;
+  static constexpr uint8_t LINK_SPEEDUP_MARGIN_DB = 15;
+
+  // Channels: every CHANNEL_PROBE_PERIOD uplinks (0 disables the probes) an
+  // uplink is restricted to one of the CHANNEL_COUNT channels to measure it,
+  // the others avoid the channels below CHANNEL_BAD_PERCENT of success while
+  // keeping at least MIN_ENABLED_CHANNELS channels.
+  static constexpr uint8_t CHANNEL_COUNT = 8;
+  static constexpr uint8_t MIN_ENABLED_CHANNELS = 3;
+  static constexpr uint8_t CHANNEL_BAD_PERCENT = 50;
+  static constexpr unsigned int CHANNEL_PROBE_PERIOD = 5;
+
+  // Uplink scheduler (see Uplink.hpp): frames of records sent on UPLINK_PORT,
+  // queue of UPLINK_QUEUE_LENGTH messages checked every UPLINK_CHECK_PERIOD_MS.
+  // A message other than bulk gains one priority level every UPLINK_AGING_MS,
+  // messages less urgent than the data wait at most UPLINK_MAX_WAIT_MS, and
+  // only urgent frames may use the last UPLINK_RESERVE_PERCENT of the duty cycle budget.
+  static constexpr uint8_t UPLINK_PORT = 4;
+  static constexpr uint8_t UPLINK_QUEUE_LENGTH = 8;
+  static constexpr uint8_t UPLINK_MESSAGE_MAX_LENGTH = 64;
+  static constexpr unsigned long UPLINK_CHECK_PERIOD_MS = 1000;
+  static constexpr unsigned long UPLINK_AGING_MS = 600000;
+  static constexpr unsigned long UPLINK_MAX_WAIT_MS = 1800000;
+  static constexpr uint8_t UPLINK_RESERVE_PERCENT = 20;
+
+  // Join: a failed join is retried after JOIN_BACKOFF_MIN_MS, the delay
+  // doubling at each failure up to JOIN_BACKOFF_MAX_MS. Each attempt is
+  // charged to the duty cycle budget at JOIN_DATA_RATE: the modem chooses
+  // the data rate of its join requests, DR0 is the worst case.
+  static constexpr unsigned long JOIN_BACKOFF_MIN_MS = 15000;
+  static constexpr unsigned long JOIN_BACKOFF_MAX_MS = 3600000;
+  static constexpr uint8_t JOIN_DATA_RATE = 0;
+
+  // Fragmentation (see Fragment.hpp): the messages of up to FRAGMENT_MAX_LENGTH
+  // bytes which do not fit a frame of MIN_DATA_RATE are sent in fragments of
+  // FRAGMENT_SIZE bytes, followed by FRAGMENT_REDUNDANCY parity fragments.
+  static constexpr uint8_t FRAGMENT_SIZE = 32;
+  static constexpr uint16_t FRAGMENT_MAX_LENGTH = 256;
+  static constexpr uint8_t FRAGMENT_REDUNDANCY = 2;
+
+  // History (see History.hpp): HISTORY_ROWS flash rows of 256 bytes keep the
+  // compressed samples, and a backfill request queues one history page every
+  // BACKFILL_PERIOD_MS once the previous one has been sent.
+  static constexpr uint16_t HISTORY_ROWS = 64;
+  static constexpr unsigned long BACKFILL_PERIOD_MS = 10000;
+
+  // Health message queued every HEALTH_PERIOD_MS
+  static constexpr unsigned long HEALTH_PERIOD_MS = 3600000;
+
+  // Derived metrics (see Metrics.hpp), computed for each sample when enabled:
+  // the condensation alarm is raised when the temperature is less than
+  // CONDENSATION_MARGIN above the dew point, and cleared CONDENSATION_HYSTERESIS
+  // further, in 0.01 degree C. METRICS_BENCHMARK compares the fixed-point
+  // metrics with their float references at boot.
+  static constexpr bool DERIVED_METRICS = true;
+  static constexpr int16_t CONDENSATION_MARGIN = 200;
+  static constexpr int16_t CONDENSATION_HYSTERESIS = 100;
+  static constexpr bool METRICS_BENCHMARK = false;
+
+  // SHT31 sensor: the I2C bus is cleared and the sensor reset after
+  // SHT31_MAX_FAILURES measurements in a row are not acknowledged
+  static constexpr uint8_t SHT31_ADDRESS = 0x44;
+  static constexpr uint8_t SHT31_MAX_FAILURES = 3;
+
+  // SHT31 heater (see Heater.hpp): when a sample reaches HEATER_RH_THRESHOLD
+  // (0.01 %), the heater is switched on for HEATER_PULSE_MS, at most once every
+  // HEATER_PERIOD_MS, to dry a saturated sensor. The samples taken while heating
+  // and HEATER_SETTLE_MS after are flagged. HEATER_POWER_MW is the power of the
+  // heater at the supply voltage of the board (3.6 to 33 mW in the datasheet),
+  // for the energy counter of the health frame.
+  static constexpr bool HEATER_ENABLED = true;
+  static constexpr int16_t HEATER_RH_THRESHOLD = 9500;
+  static constexpr unsigned long HEATER_PULSE_MS = 10000;
+  static constexpr unsigned long HEATER_PERIOD_MS = 900000;
+  static constexpr unsigned long HEATER_SETTLE_MS = 60000;
+  static constexpr uint16_t HEATER_POWER_MW = 10;
+
+  // Application: one sample every REPORT_INTERVAL_MS, BATCH_SIZE samples per uplink
+  static constexpr unsigned long REPORT_INTERVAL_MS = 10000;
+  static constexpr uint8_t SAMPLE_SIZE = 4;
+  static constexpr uint8_t BATCH_SIZE = 1;
+
+  // Forward error correction (see Redundancy.hpp): each data record is followed
+  // by the parity of the DATA_PARITY_DEPTH previous ones (0 disables it).
+  static constexpr uint8_t DATA_PARITY_DEPTH = 0;
+};
+
+// Site variants, selected with -DNODE_CONFIG=<name>
+
+// Production image, personalized per device by tools/factory_images.py
+struct FactoryProvisioningConfig : DefaultConfig
+{
+  static constexpr bool FACTORY_CREDENTIALS = true;
+};
+
+// Site at the edge of the coverage: the slowest data rate, so the history
+// pages are fragmented, and data records protected by their parity
+struct EdgeOfCoverageConfig : DefaultConfig
+{
+  static constexpr uint8_t DATA_RATE = 0;
+  static constexpr uint8_t MIN_DATA_RATE = 0;
+  static constexpr unsigned long REPORT_INTERVAL_MS = 300000;
+  static constexpr uint8_t BATCH_SIZE = 2;
+  static constexpr uint8_t DATA_PARITY_DEPTH = 4;
+};
+
+#ifndef NODE_CONFIG
+#define NODE_CONFIG DefaultConfig
+#endif
+
+// Configuration used by the whole firmware
+typedef NODE_CONFIG Config;
+
+// Type and length bytes preceding each record of an uplink frame
+#define UPLINK_RECORD_HEADER_SIZE 2
+
+// Sequence number of the first sample, at the start of a data record
+#define DATA_SEQUENCE_SIZE 4
+
+/**
+ * @brief Returns the size of the flags of a data record, four bits per sample.
+ */
+constexpr uint16_t configDataFlagsSize()
+{
+  return (Config::BATCH_SIZE + 1) / 2;
+}
+
+/**
+ * @brief Returns the size of the value of a data record.
+ */
+constexpr uint16_t configDataRecordSize()
+{
+  return DATA_SEQUENCE_SIZE + configDataFlagsSize() + Config::SAMPLE_SIZE * Config::BATCH_SIZE;
+}
+
+/**
+ * @brief Returns the size of the value of a parity record.
+ */
+constexpr uint16_t configParityRecordSize()
+{
+  return configDataRecordSize() + 1;
+}
+
+/**
+ * @brief Returns the size of the application payload of a data uplink, a data record and its parity.
+ */
+constexpr uint16_t configPayloadSize()
+{
+  return UPLINK_RECORD_HEADER_SIZE + configDataRecordSize()
+    + (Config::DATA_PARITY_DEPTH > 0 ? UPLINK_RECORD_HEADER_SIZE + configParityRecordSize() : 0);
+}
+
+/**
+ * @brief Returns the interval between two data uplinks in milliseconds.
+ */
+constexpr uint32_t configUplinkIntervalMs()
+{
+  return Config::REPORT_INTERVAL_MS * Config::BATCH_SIZE;
+}
+
+static_assert(Config::DATA_RATE <= 6, "DATA_RATE must be an EU868 LoRa data rate (DR0 to DR6)");
+static_assert(Config::BATCH_SIZE > 0, "BATCH_SIZE must be at least one sample");
+static_assert(Config::TX_TRANSMISSIONS > 0, "TX_TRANSMISSIONS must be at least one transmission");
+static_assert(Config::MIN_DATA_RATE <= Config::DATA_RATE, "MIN_DATA_RATE must not be faster than DATA_RATE");
+static_assert(configPayloadSize() <= eu868MaxPayload(Config::MIN_DATA_RATE), "A data record of BATCH_SIZE samples and its parity exceed the maximum payload of MIN_DATA_RATE");
+static_assert(eu868DutyCyclePpm(configPayloadSize(), Config::MIN_DATA_RATE, Config::TX_TRANSMISSIONS, configUplinkIntervalMs()) <= EU868_MAX_DUTY_CYCLE_PPM,
+  "The worst-case time on air of the uplinks exceeds the EU868 1 % duty cycle, increase REPORT_INTERVAL_MS or BATCH_SIZE, or use a faster MIN_DATA_RATE");
+static_assert(Config::UPLINK_PORT >= 1 && Config::UPLINK_PORT <= 223, "UPLINK_PORT must be an application port (1 to 223)");
+static_assert(Config::UPLINK_QUEUE_LENGTH > 0 && Config::UPLINK_MESSAGE_MAX_LENGTH > 0 && Config::UPLINK_MESSAGE_MAX_LENGTH <= 255,
+  "The uplink queue must hold at least one message, of at most 255 bytes");
+static_assert(Config::FRAGMENT_SIZE > 0, "FRAGMENT_SIZE must be positive");
+static_assert(Config::HISTORY_ROWS > 0 && Config::HISTORY_ROWS <= 512, "The history needs at least one flash row and at most half of the flash");
+static_assert(Config::UPLINK_AGING_MS > 0, "UPLINK_AGING_MS must be positive");
+static_assert(Config::UPLINK_RESERVE_PERCENT < 100, "UPLINK_RESERVE_PERCENT must leave a budget to the non-urgent frames");
+static_assert(Config::JOIN_BACKOFF_MIN_MS > 0 && Config::JOIN_BACKOFF_MIN_MS <= Config::JOIN_BACKOFF_MAX_MS,
+  "JOIN_BACKOFF_MIN_MS must be positive and at most JOIN_BACKOFF_MAX_MS");
+static_assert(Config::JOIN_DATA_RATE <= 5, "JOIN_DATA_RATE must be an EU868 LoRa data rate (0 to 5)");
+static_assert(Config::CHANNEL_COUNT >= 3 && Config::CHANNEL_COUNT <= 16, "EU868 devices have 3 default channels and at most 16 channels");
+static_assert(Config::MIN_ENABLED_CHANNELS >= 3 && Config::MIN_ENABLED_CHANNELS <= Config::CHANNEL_COUNT,
+  "At least 3 channels must stay enabled so that the uplinks hop between frequencies");
+static_assert(Config::LINK_LOST_PERCENT < Config::LINK_SLOWDOWN_PERCENT, "LINK_LOST_PERCENT must be below LINK_SLOWDOWN_PERCENT");
+static_assert(Config::DEVICE_CLASS == 'A' || Config::DEVICE_CLASS == 'C',
+  "DEVICE_CLASS must be 'A' or 'C': the modem firmware does not expose class B beacon and ping slot settings, use class C windows instead");
+static_assert(Config::DEVICE_CLASS != 'C' || !Config::MODEM_POWER_SAVE, "A permanent class C requires MODEM_POWER_SAVE to be disabled");
+static_assert(Config::CLASS_C_WINDOW_PERIOD_MS == 0 || Config::CLASS_C_WINDOW_DURATION_MS < Config::CLASS_C_WINDOW_PERIOD_MS,
+  "CLASS_C_WINDOW_DURATION_MS must be shorter than CLASS_C_WINDOW_PERIOD_MS");
+static_assert(Config::CONDENSATION_MARGIN >= 0 && Config::CONDENSATION_HYSTERESIS >= 0, "The condensation thresholds must not be negative");
+static_assert(Config::MAGIC_NUMBER < 255, "MAGIC_NUMBER + 1 must fit in one NVM byte");
+static_assert(Config::MAX_TX_ERRORS > 0, "MAX_TX_ERRORS must be positive");
+static_assert(Config::SHT31_ADDRESS == 0x44 || Config::SHT31_ADDRESS == 0x45, "The SHT31 only answers on 0x44 or 0x45");
+static_assert(Config::SHT31_MAX_FAILURES > 0, "SHT31_MAX_FAILURES must be at least one failure");
+static_assert(Config::HEATER_RH_THRESHOLD > 0 && Config::HEATER_RH_THRESHOLD <= 10000, "HEATER_RH_THRESHOLD must be a humidity in 0.01 %");
+static_assert(Config::HEATER_PULSE_MS > 0 && Config::HEATER_PULSE_MS + Config::HEATER_SETTLE_MS < Config::HEATER_PERIOD_MS,
+  "A heater pulse and its settling time must end before the next pulse may start");
+
+#endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+ * File: Console.cpp
+ *
+ * Description:
+ * This source file implements the console of the node. Every diagnostic
+ * is written into a RAM ring buffer, which is drained to the USB Serial
+ * interface only when a host is connected and only as fast as the link
+ * accepts it, so writing to the console never blocks. The input is
+ * assembled into lines by Console::readLine().
+ *
+ * Functions:
+ * - init_Console: Starts the USB Serial interface.
+ * - updateConsole: Drains the buffered diagnostics to the host.
+ * - consoleConnected: Indicates whether a host is connected.
+ *
+ * Note:
+ * A host is detected by the DTR signal of the USB CDC interface, which
+ * terminal programs assert when they open the port.
+ */
+
+#include "Console.hpp"
+
+// Console object used instead of Serial by the whole firmware.
+Console console;
+
+/**
+ * @brief Writes a character to the console.
+ *
+ * The character is appended to the ring buffer, dropping the oldest one
+ * if the buffer is full, then the buffer is drained as far as possible.
+ *
+ * @param c The character to write.
+ *
+ * @return 1, the character is always accepted.
+ */
+size_t Console::write(uint8_t c)
+{
+  if (count == CONSOLE_BUFFER_SIZE)
+  {
+    head = (head + 1) % CONSOLE_BUFFER_SIZE;
+    count --;
+  }
+  buffer[(head + count) % CONSOLE_BUFFER_SIZE] = c;
+  count ++;
+
+  drain();
+  return 1;
+}
+
+/**
+ * @brief Returns the room left in the ring buffer.
+ */
+int Console::availableForWrite()
+{
+  return CONSOLE_BUFFER_SIZE - count;
+}
+
+/**
+ * @brief Returns the number of characters received from the host.
+ */
+int Console::available()
+{
+  return Serial.available();
+}
+
+/**
+ * @brief Reads a character received from the host.
+ *
+ * @return The character, or -1 if none is available.
+ */
+int Console::read()
+{
+  return Serial.read();
+}
+
+/**
+ * @brief Returns the next character received from the host without removing it.
+ *
+ * @return The character, or -1 if none is available.
+ */
+int Console::peek()
+{
+  return Serial.peek();
+}
+
+/**
+ * @brief Reads the next complete line received from the host, without blocking.
+ *
+ * The characters are consumed one by one until a CR or a LF. A LF right
+ * after a CR is skipped, so CR, LF and CRLF terminals all end a line once.
+ * The characters of a line longer than CONSOLE_LINE_MAX_LENGTH are
+ * dropped until its end.
+ *
+ * @param line The buffer receiving the null-terminated line, without its terminator.
+ * @param size The size of the buffer, including the null terminator.
+ *
+ * @return The length of the line, CONSOLE_LINE_TOO_LONG if it did not fit
+ *         CONSOLE_LINE_MAX_LENGTH or the buffer, or CONSOLE_NO_LINE if no
+ *         complete line has been received yet.
+ */
+int Console::readLine(char line[], size_t size)
+{
+  int c;
+  while ((c = Serial.read()) >= 0)
+  {
+    bool carriageReturn = lastCarriageReturn;
+    lastCarriageReturn = c == '\r';
+    if (c == '\n' && carriageReturn)
+    {
+      continue;
+    }
+
+    if (c != '\r' && c != '\n')
+    {
+      if (inputLength < CONSOLE_LINE_MAX_LENGTH)
+      {
+        input[inputLength++] = c;
+      }
+      else
+      {
+        inputOverflow = true;
+      }
+      continue;
+    }
+
+    int length = inputLength;
+    bool overflow = inputOverflow || (size_t)length >= size;
+    inputLength = 0;
+    inputOverflow = false;
+    if (overflow)
+    {
+      return CONSOLE_LINE_TOO_LONG;
+    }
+    memcpy(line, input, length);
+    line[length] = '\0';
+    return length;
+  }
+  return CONSOLE_NO_LINE;
+}
+
+/**
+ * @brief Sends the buffered characters the USB link can accept without blocking.
+ *
+ * Nothing is sent while no host is connected.
+ */
+void Console::drain()
+{
+  if (!consoleConnected())
+  {
+    return;
+  }
+
+  int room = Serial.availableForWrite();
+  while (count > 0 && room > 0)
+  {
+    // Send the contiguous part of the buffer in one USB transfer
+    uint16_t length = min((int)count, min(room, CONSOLE_BUFFER_SIZE - (int)head));
+    size_t sent = Serial.write(&buffer[head], length);
+    if (sent == 0)
+    {
+      return;
+    }
+    head = (head + sent) % CONSOLE_BUFFER_SIZE;
+    count -= sent;
+    room -= sent;
+  }
+}
+
+/**
+ * @brief Starts the USB Serial interface.
+ *
+ * Unlike a `while(!Serial)` loop, this function does not wait for a host.
+ */
+void init_Console()
+{
+  Serial.begin(Config::CONSOLE_BAUDRATE);
+}
+
+/**
+ * @brief Drains the buffered diagnostics to the host.
+ *
+ * Registered as a periodic task of the scheduler, and called by the loops
+ * waiting for console input.
+ */
+void updateConsole()
+{
+  console.drain();
+}
+
+/**
+ * @brief Indicates whether a host is connected to the console.
+ *
+ * @return true if the USB Serial port is opened by a host.
+ */
+bool consoleConnected()
+{
+  return (bool)Serial;
+}
@@ -0,0 +1,74 @@
+/*
+ * File: Console.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the console of the node.
+ * The console replaces direct uses of the USB Serial interface: every
+ * diagnostic is written into a RAM ring buffer, which is drained to the
+ * host only when one is connected and only as fast as the USB link
+ * accepts it. Writing to the console never blocks, so a headless node
+ * boots and samples without waiting for a host.
+ *
+ * When the buffer is full, the oldest characters are dropped: a host
+ * connecting late receives the most recent diagnostics.
+ *
+ * The input is assembled into lines of at most CONSOLE_LINE_MAX_LENGTH
+ * characters, terminated by CR, LF or CRLF. readLine() returns as soon as
+ * a line is complete, leaving the rest of a burst in the USB buffer, so
+ * that several pasted commands are handled one by one.
+ *
+ * Functions:
+ * - init_Console: Starts the USB Serial interface.
+ * - updateConsole: Drains the buffered diagnostics to the host.
+ * - consoleConnected: Indicates whether a host is connected.
+ */
+
+#ifndef HPP__CONSOLE__HPP
+#define HPP__CONSOLE__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+#define CONSOLE_BUFFER_SIZE 512
+#define CONSOLE_UPDATE_PERIOD_MS 20
+#define CONSOLE_LINE_MAX_LENGTH 80
+
+// Results of Console::readLine() other than a line length
+#define CONSOLE_NO_LINE -1
+#define CONSOLE_LINE_TOO_LONG -2
+
+/**
+ * @brief Non-blocking console, input is read from the host, output is buffered.
+ */
+class Console : public Stream
+{
+public:
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int availableForWrite() override;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  void drain();
+  int readLine(char line[], size_t size);
+
+private:
+  uint8_t buffer[CONSOLE_BUFFER_SIZE];
+  uint16_t head = 0;
+  uint16_t count = 0;
+
+  // Line being assembled from the input
+  char input[CONSOLE_LINE_MAX_LENGTH];
+  uint8_t inputLength = 0;
+  bool inputOverflow = false;
+  bool lastCarriageReturn = false;
+};
+
+extern Console console;
+
+void init_Console();
+void updateConsole();
+bool consoleConnected();
+
+#endif
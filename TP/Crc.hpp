@@ -0,0 +1,74 @@
+/*
+ * File: Crc.hpp
+ *
+ * Description:
+ * This header file provides the CRC-16/CCITT (polynomial 0x1021, initial
+ * value 0xFFFF, also known as CRC-16/CCITT-FALSE) shared by the
+ * configuration digest, the provisioning messages and the factory
+ * credentials. The host tools compute the same CRC with
+ * binascii.crc_hqx(data, 0xFFFF).
+ *
+ * Functions:
+ * - crc16CcittBits: Shifts the bits of a byte through the CRC.
+ * - crc16CcittByte: Updates the CRC with a byte.
+ * - crc16Ccitt: Computes the CRC of a buffer.
+ * - crc16CcittText: Computes the CRC of a null-terminated string at compile time.
+ *
+ * Note:
+ * The Arduino SAMD core compiles with -std=gnu++11, so every constexpr
+ * function is a single return statement.
+ */
+
+#ifndef HPP__CRC__HPP
+#define HPP__CRC__HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC16_CCITT_INIT 0xFFFF
+
+/**
+ * @brief Shifts the bits of a byte through the CRC-16/CCITT.
+ */
+constexpr uint16_t crc16CcittBits(uint16_t crc, uint8_t bits)
+{
+  return bits == 0 ? crc : crc16CcittBits(crc & 0x8000 ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1), bits - 1);
+}
+
+/**
+ * @brief Updates the CRC-16/CCITT with a byte.
+ */
+constexpr uint16_t crc16CcittByte(uint16_t crc, uint8_t byte)
+{
+  return crc16CcittBits(crc ^ ((uint16_t)byte << 8), 8);
+}
+
+/**
+ * @brief Computes the CRC-16/CCITT of a buffer.
+ *
+ * @param data The bytes to check.
+ * @param length The number of bytes.
+ * @param crc The CRC of the previous bytes, CRC16_CCITT_INIT for the first ones.
+ *
+ * @return The CRC.
+ */
+inline uint16_t crc16Ccitt(const uint8_t data[], size_t length, uint16_t crc = CRC16_CCITT_INIT)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    crc = crc16CcittByte(crc, data[i]);
+  }
+  return crc;
+}
+
+/**
+ * @brief Computes the CRC-16/CCITT of a null-terminated string, without its terminator.
+ */
+constexpr uint16_t crc16CcittText(const char *text, uint16_t crc = CRC16_CCITT_INIT)
+{
+  return *text == '\0' ? crc : crc16CcittText(text + 1, crc16CcittByte(crc, *text));
+}
+
+static_assert(crc16CcittByte(crc16CcittByte(CRC16_CCITT_INIT, 'A'), 'B') == 0x4B74, "CRC-16/CCITT-FALSE of \"AB\" must be 0x4B74");
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * File: Downlink.cpp
+ *
+ * Description:
+ * This source file implements the downlink dispatcher. A downlink is
+ * read from the modem into a fixed-size buffer, and its first byte
+ * selects the command handler it is passed to. The commands are
+ * acknowledged by records piggybacked onto the next data frame.
+ *
+ * Functions:
+ * - registerDownlinkHandler: Registers the handler of a downlink command.
+ * - pollDownlink: Reads a pending downlink from the modem and dispatches it.
+ * - processDownlink: Dispatches a downlink to the handler of its command.
+ *
+ * Note:
+ * modem.available() also reads the downlinks the modem reports
+ * asynchronously in class C.
+ */
+
+#include "Downlink.hpp"
+#include "Driver_LoRaWan.hpp"
+#include "Uplink.hpp"
+#include "Health.hpp"
+
+// Entry of the handler table
+struct DownlinkCommand
+{
+  uint8_t command;
+  DownlinkHandler handler;
+};
+
+// Registered command handlers, a null handler marks a free entry.
+static DownlinkCommand handlers[DOWNLINK_MAX_HANDLERS];
+
+/**
+ * @brief Queues the acknowledgement of a downlink command.
+ *
+ * @param command The command byte.
+ * @param status The acknowledgement status, DOWNLINK_ACK_*.
+ */
+static void acknowledgeDownlink(uint8_t command, uint8_t status)
+{
+  uint8_t ack[2] = { command, status };
+  appendUplink(UPLINK_ACK, PRIORITY_ACK, ack, sizeof(ack));
+}
+
+/**
+ * @brief Registers the handler of a downlink command.
+ *
+ * @param command The command byte.
+ * @param handler The function processing the command.
+ *
+ * @return true if the handler is registered, false if the table is full.
+ */
+bool registerDownlinkHandler(uint8_t command, DownlinkHandler handler)
+{
+  for (int i = 0; i < DOWNLINK_MAX_HANDLERS; i++)
+  {
+    if (handlers[i].handler == NULL || handlers[i].command == command)
+    {
+      handlers[i].command = command;
+      handlers[i].handler = handler;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Reads a pending downlink from the modem and dispatches it.
+ *
+ * Bytes beyond DOWNLINK_MAX_LENGTH are read and dropped, the truncated
+ * downlink is rejected.
+ *
+ * @return true if a downlink was received.
+ */
+bool pollDownlink()
+{
+  if (!modem.available())
+  {
+    return false;
+  }
+
+  uint8_t downlink[DOWNLINK_MAX_LENGTH];
+  size_t length = 0;
+  bool truncated = false;
+  while (modem.available())
+  {
+    int c = modem.read();
+    if (length < DOWNLINK_MAX_LENGTH)
+    {
+      downlink[length++] = (uint8_t)c;
+    }
+    else
+    {
+      truncated = true;
+    }
+  }
+
+  if (truncated)
+  {
+    console.println("Downlink too long, ignored");
+    acknowledgeDownlink(downlink[0], DOWNLINK_ACK_TRUNCATED);
+  }
+  else
+  {
+    processDownlink(downlink, length);
+  }
+  return true;
+}
+
+/**
+ * @brief Dispatches a downlink to the handler of its command and acknowledges it.
+ *
+ * An accepted command may change the configuration, so its acknowledgement
+ * is followed by the configuration digest.
+ *
+ * @param downlink The downlink payload, starting with the command byte.
+ * @param length The length of the payload.
+ */
+void processDownlink(const uint8_t downlink[], size_t length)
+{
+  if (length == 0)
+  {
+    return;
+  }
+
+  for (int i = 0; i < DOWNLINK_MAX_HANDLERS; i++)
+  {
+    if (handlers[i].handler != NULL && handlers[i].command == downlink[0])
+    {
+      if (handlers[i].handler(&downlink[1], length - 1))
+      {
+        acknowledgeDownlink(downlink[0], DOWNLINK_ACK_ACCEPTED);
+        queueConfigDigest();
+      }
+      else
+      {
+        acknowledgeDownlink(downlink[0], DOWNLINK_ACK_REJECTED);
+      }
+      return;
+    }
+  }
+  console.print("Unknown downlink command: ");
+  console.println(downlink[0]);
+  acknowledgeDownlink(downlink[0], DOWNLINK_ACK_UNKNOWN);
+}
@@ -0,0 +1,49 @@
+/*
+ * File: Downlink.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the downlink dispatcher.
+ * A downlink is read from the modem into a fixed-size buffer, and its
+ * first byte selects the command handler it is passed to. The other
+ * modules register their commands at startup.
+ *
+ * Each command is acknowledged by an UPLINK_ACK record of two bytes,
+ * [command] [status], followed by the configuration digest (see Health.hpp)
+ * once a command has been accepted. The acknowledgements do not trigger
+ * an uplink: they are packed into the next data frame, several of them
+ * sharing a single record.
+ *
+ * Functions:
+ * - registerDownlinkHandler: Registers the handler of a downlink command.
+ * - pollDownlink: Reads a pending downlink from the modem and dispatches it.
+ * - processDownlink: Dispatches a downlink to the handler of its command.
+ */
+
+#ifndef HPP__DOWNLINK__HPP
+#define HPP__DOWNLINK__HPP
+
+#include <Arduino.h>
+#include "Console.hpp"
+
+#define DOWNLINK_MAX_LENGTH 64
+#define DOWNLINK_MAX_HANDLERS 8
+
+// Commands, first byte of a downlink
+#define DOWNLINK_CMD_OPEN_WINDOW 0x01
+#define DOWNLINK_CMD_BACKFILL 0x02
+
+// Acknowledgement status of a downlink command
+#define DOWNLINK_ACK_ACCEPTED 0x00
+#define DOWNLINK_ACK_REJECTED 0x01
+#define DOWNLINK_ACK_UNKNOWN 0x02
+#define DOWNLINK_ACK_TRUNCATED 0x03
+
+// Handler of a downlink command, receives the bytes following the command byte
+// and returns false if they are invalid.
+typedef bool (*DownlinkHandler)(const uint8_t data[], size_t length);
+
+bool registerDownlinkHandler(uint8_t command, DownlinkHandler handler);
+bool pollDownlink();
+void processDownlink(const uint8_t downlink[], size_t length);
+
+#endif
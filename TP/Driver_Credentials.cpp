@@ -7,8 +7,9 @@
  * the definitions of functions for initializing, reading, and writing 
  * credentials such as devEUI, appEUI, and appKey. 
  * 
- * The credentials are set and stored as strings via AT commands, 
- * allowing for easy configuration by the user.
+ * The credentials are set and stored as fixed-size character buffers 
+ * via AT commands, allowing for easy configuration by the user. No 
+ * function of this driver allocates memory on the heap.
  * 
  * Functions:
  * - init_Credentials: Initializes the credential input process.
@@ -19,28 +20,102 @@
  * - isAppEUI: Validates the appEUI format.
  * - isAppKey: Validates the appKey format.
  * - readNVM: Reads a value from Non-Volatile Memory (NVM).
+ * - readNVMBlock: Reads consecutive values from NVM, one reply at a time.
  * - writeNVM: Writes a value to Non-Volatile Memory (NVM).
+ * - readModemResponse: Reads a modem reply into a fixed-size buffer.
+ * - loadFactoryCredentials: Loads the credentials written in the firmware image.
+ * - lockFactoryCredentials: Locks the flash region of the factory credentials.
  */
 
 #include "Driver_Credentials.hpp"
+#include "Health.hpp"
+#include "Crc.hpp"
+#include "Profiler.hpp"
+#include "History.hpp"
 
-// Credentials stored as strings, configured via AT commands.
-String appEui = "", appKey = "", devEui = ""; 
+// Credentials stored as null-terminated strings, configured via AT commands.
+char appEui[APPEUI_LENGTH + 1] = "";
+char appKey[APPKEY_LENGTH + 1] = "";
+char devEui[DEVEUI_LENGTH + 1] = "";
 
 // Indicates the configuration state of the credentials.
 bool configuration = false;
 
+/**
+ * @brief Credentials record of the firmware image, rewritten per device after the build.
+ *
+ * It is only emitted in a factory image: the record is a member of the
+ * template instantiated with Config::FACTORY_CREDENTIALS, and the
+ * specialization of the other images has none. It is const so that it
+ * stays in flash, and only read through a volatile pointer so that the
+ * compiler never folds the default values. Its CRC is the complement of
+ * the one of the values of Secret.hpp: the record is a template that the
+ * firmware rejects until tools/factory_images.py writes the credentials
+ * of a device and their CRC.
+ */
+template <bool FACTORY>
+struct FactoryRecord
+{
+  __attribute__((used, aligned(4))) static const FactoryCredentials record;
+
+  static const volatile FactoryCredentials *get()
+  {
+    return &record;
+  }
+};
+
+template <>
+struct FactoryRecord<false>
+{
+  static const volatile FactoryCredentials *get()
+  {
+    return NULL;
+  }
+};
+
+template <bool FACTORY>
+const FactoryCredentials FactoryRecord<FACTORY>::record =
+{
+  FACTORY_CREDENTIALS_MAGIC,
+  (uint16_t)~crc16CcittText(SECRET_APP_KEY, crc16CcittText(SECRET_APP_EUI, crc16CcittText(SECRET_DEV_EUI))),
+  SECRET_DEV_EUI,
+  SECRET_APP_EUI,
+  SECRET_APP_KEY
+};
+
+// Indicates that the credentials were set by an AT+P message, answered once saved.
+static bool bulkProvisioning = false;
+
+// Copy of the credentials state kept in RAM across warm resets, 
+// to skip the NVM probing of the modem at boot. The linker scripts of the
+// SAMD core have no .noinit output section: tools/noinit.ld adds one after
+// .bss, outside the areas cleared or copied by the startup code.
+struct CredentialsCache
+{
+  uint32_t magic;
+  uint32_t check;
+};
+static CredentialsCache credentialsCache __attribute__((section(".noinit")));
+
+static bool credentialsCacheValid();
+static void setCredentialsCache(bool init);
+static const char *provision(const char *message);
+
 /**
  * @brief Initializes the credentials by waiting for AT commands from the user.
  *
- * This function prepares the system to receive AT commands from the Serial interface.
- * It listens for input until a valid command is received (indicated by a newline character).
+ * This function prepares the system to receive AT commands from the console.
+ * It listens for input until a valid command is received (indicated by a line terminator).
  * Once the credentials are initied, it updates the NVM with specific values.
  *
  * It performs the following steps:
- * - Reserves memory for input commands.
- * - Waits for user input on the Serial interface.
- * - Processes the received command when a complete string is detected.
+ * - Waits for user input on the console, draining the console output meanwhile.
+ * - Reads the input line by line with readCommands(), discarding lines
+ *   longer than COMMAND_MAX_LENGTH or holding a NUL or control character,
+ *   and ignoring empty lines.
+ * - Processes each command as soon as its line is complete, so that a batch
+ *   of pasted commands is handled one command at a time. The console is 
+ *   polled every millisecond.
  * - Updates the NVM with a status and a magic number.
  * - Sends a command to the LoRa modem to lock the AppKey access.
  *
@@ -52,43 +127,79 @@ bool configuration = false;
  */
 void init_Credentials()
 {
-  Serial.println("Ready to receive AT commands. Type AT? for assistance");
-  String inputString = ""; 
-  inputString.reserve(200);    
-  bool stringComplete = false;  
+  console.println("Ready to receive AT commands. Type AT? for assistance");
 
   while(!configuration)
   {
-    while (Serial.available()) 
+    readCommands();
+    updateConsole();
+    delay(1);
+  }
+  profileEnd(PHASE_CREDENTIALS);
+
+  profileStart(PHASE_NVM_SAVE);
+  bool saved = writeNVM(1,1);
+  saved &= writeNVM(2,Config::MAGIC_NUMBER+1);
+  SerialLoRa.println("AT$APKACCESS");
+  setCredentialsCache(true);
+  profileEnd(PHASE_NVM_SAVE);
+
+  if (bulkProvisioning)
+  {
+    char response[16] = "+ERR NVM";
+    if (saved)
     {
-      char inChar = (char)Serial.read();
-      inputString += inChar;
-      if (inChar == '\n') 
-      {
-        stringComplete = true;
-      }
+      snprintf(response, sizeof(response), "+OK %04X", configDigest());
     }
+    console.println(response);
+    updateConsole();
+  }
+}
 
-    if(stringComplete == true)
+/**
+ * @brief Processes the command lines received on the console.
+ *
+ * Lines longer than COMMAND_MAX_LENGTH or holding a NUL or control
+ * character are discarded, and empty lines ignored. Each complete line is
+ * processed at once, and the function returns when no complete line is
+ * left or when the configuration is finished, leaving the next lines.
+ */
+void readCommands()
+{
+  char command[COMMAND_MAX_LENGTH + 1];
+  int length;
+  while (!configuration && (length = console.readLine(command, sizeof(command))) != CONSOLE_NO_LINE)
+  {
+    // A NUL or a control character would truncate or hide a part of the command
+    bool garbled = false;
+    for (int i = 0; i < length; i++)
     {
-      processCommand(inputString);
+      garbled |= command[i] < ' ' || command[i] > '~';
+    }
 
-      inputString = "";
-      stringComplete = false;
+    if (length == CONSOLE_LINE_TOO_LONG)
+    {
+      console.println("Command too long, please try again");
+    }
+    else if (garbled)
+    {
+      console.println("Invalid character in the command, please try again");
+    }
+    else if (length > 0)
+    {
+      processCommand(command);
     }
-    delay(100);
   }
-  writeNVM(1,1);
-  writeNVM(2,MAGICNUMBER+1);
-  SerialLoRa.println("AT$APKACCESS");
 }
 
 /**
  * @brief Checks if the credentials have already been initialized.
  *
- * This function reads values from NVM to determine
- * if the credentials have been set up correctly. It checks the following:
- * - The magic number stored at address 0 matches the expected MAGICNUMBER.
+ * After a warm reset, the state recorded in RAM by the previous run is used
+ * and the modem is not probed. Otherwise, this function reads values from NVM 
+ * in one pass to determine if the credentials have been set up 
+ * correctly. It checks the following:
+ * - The magic number stored at address 0 matches the expected Config::MAGIC_NUMBER.
  * - The state stored at address 1 is equal to 1.
  * - The checksum, stored at address 2, is valid, which is calculated by
  *   summing the magic number and the state.
@@ -96,114 +207,137 @@ void init_Credentials()
  * @return true if the credentials are already initialized and valid,
  *         false otherwise.
  *
- * @see readNVM() for details on reading to the Non-Volatile Memory.
+ * @see readNVMBlock() for details on reading to the Non-Volatile Memory.
  */
 bool credentialsAlreadyInit()
 {
-  uint8_t magicNumber = readNVM(0);
-  uint8_t state = readNVM(1);
-  uint8_t checksum = readNVM(2);
+  if(credentialsCacheValid())
+  {
+    return true;
+  }
+
+  uint8_t values[3];
+  readNVMBlock(0, 3, values);
+  uint8_t magicNumber = values[0];
+  uint8_t state = values[1];
+  uint8_t checksum = values[2];
   bool init = true;
-  if(magicNumber != MAGICNUMBER || state != 1 || magicNumber + state != checksum)
+  if(magicNumber != Config::MAGIC_NUMBER || state != 1 || magicNumber + state != checksum)
   {
     init = false;
   }
+  setCredentialsCache(init);
   return init;
 }
 
 /**
- * @brief Processes an incoming AT command string.
+ * @brief Processes an incoming AT command line.
  *
  * This function interprets and executes various AT commands received
  * via the serial interface. The following commands are supported:
- * - "AT?\n": Displays a list of available commands.
+ * - "AT?": Displays a list of available commands.
  * - "AT+D=<devEUI>": Configures the device EUI.
  * - "AT+A=<appEUI>": Configures the application EUI.
  * - "AT+K=<appKey>": Configures the application key.
- * - "AT+S\n": Saves the configured credentials.
+ * - "AT+S": Saves the configured credentials.
+ * - "AT+P=<devEUI>,<appEUI>,<appKey>,<CRC>": Sets and saves every credential
+ *   at once, for production tools. It is answered by "+ERR <reason>" if it is
+ *   rejected, and by "+OK <configuration digest>" once the credentials are saved.
  *
  * The function also validates the input for devEUI, appEUI, and appKey
  * using their respective validation functions. If a command is invalid or
- * incomplete, an appropriate error message is displayed.
+ * incomplete, an appropriate error message is displayed. A command is only
+ * recognized with its exact prefix, "=" included, and "AT+S" is only
+ * accepted once the three stored credentials are valid.
  *
- * @param command The AT command string to be processed.
+ * @param command The null-terminated AT command line to be processed,
+ *                without its line terminator.
  *
  * @note The function modifies the global variables `devEui`, `appEui`,
  *       and `appKey` based on the received commands. The `configuration`
  *       variable is set to true upon successful configuration of all
  *       credentials.
  */
-void processCommand(String command)
+void processCommand(const char *command)
 {
-  if (command == "AT?\n")
+  // Value following the "AT+X=" prefix, empty if the command is shorter
+  const char *value = strlen(command) >= 5 ? command + 5 : "";
+
+  if (strcmp(command, "AT?") == 0)
   {
-    Serial.println("");
-    Serial.println("Commands available : ");
-    Serial.println("AT+D=<devEUI> : Configure the devEUI");
-    Serial.println("AT+A=<appEUI> : Configure the appEUI");
-    Serial.println("AT+K=<appKey> : Configure the appKey");
-    Serial.println("AT+S : Save and protecte credentials");
+    console.println("");
+    console.println("Commands available : ");
+    console.println("AT+D=<devEUI> : Configure the devEUI");
+    console.println("AT+A=<appEUI> : Configure the appEUI");
+    console.println("AT+K=<appKey> : Configure the appKey");
+    console.println("AT+S : Save and protect the credentials");
+    console.println("AT+P=<devEUI>,<appEUI>,<appKey>,<CRC> : Configure and save all the credentials");
   }
 
-  else if (command.startsWith("AT+D="))
+  else if (strncmp(command, "AT+D=", 5) == 0)
   {
-    command.remove(0,5);
-    
-    if(isDevEUI(command))
+    if(isDevEUI(value))
     {
-      devEui = command;
-      Serial.println("DevEUI OK");
+      strcpy(devEui, value);
+      console.println("DevEUI OK");
     }
     else
     {
-      Serial.println("DevEUI incorrect, please try again");
+      console.println("DevEUI incorrect, please try again");
     }
   }
 
-  else if (command.startsWith("AT+A"))
+  else if (strncmp(command, "AT+A=", 5) == 0)
   {
-    command.remove(0,5);
-
-    if(isAppEUI(command))
+    if(isAppEUI(value))
     {
-      appEui = command;
-      Serial.println("AppEUI OK");
+      strcpy(appEui, value);
+      console.println("AppEUI OK");
     }
     else
     {
-      Serial.println("AppEUI incorrect, please try again");
+      console.println("AppEUI incorrect, please try again");
     }
   }
-  else if(command.startsWith("AT+K"))
+  else if(strncmp(command, "AT+K=", 5) == 0)
   {
-    command.remove(0,5);
-
-    if(isAppKey(command))
+    if(isAppKey(value))
     {
-      appKey = command;
-      Serial.println("AppKey OK");
+      strcpy(appKey, value);
+      console.println("AppKey OK");
     }
     else
     {
-      Serial.println("AppKey incorrect, please try again");
+      console.println("AppKey incorrect, please try again");
+    }
+  }
+  else if(strncmp(command, "AT+P=", 5) == 0)
+  {
+    const char *error = provision(value);
+    if(error != NULL)
+    {
+      console.print("+ERR ");
+      console.println(error);
     }
   }
-  else if(command == "AT+S\n")
+  else if(strcmp(command, "AT+S") == 0)
   {
-    if(appEui!="" && appEui!="" && appKey!="")
+    // Only valid credentials are stored, they are checked again so that
+    // the modem is never configured with a partial or corrupted set
+    if(isDevEUI(devEui) && isAppEUI(appEui) && isAppKey(appKey))
     {
-      Serial.println("Configuration of the credentials finished");
+      console.println("Configuration of the credentials finished");
       configuration = true;
       
     }
     else
     {
-      Serial.println("You have to configure all the credentials");
+      console.println("You have to configure all the credentials");
     }
   }
   else
   {
-    Serial.println("Invalid command, type AT? for assistance");
+    console.println("Invalid command, type AT? for assistance");
   }
 }
 
@@ -212,27 +346,25 @@ void processCommand(String command)
  *
  * This function checks if the provided credential string meets the 
  * specified length and consists solely of valid hexadecimal characters 
- * (0-9, A-F, a-f). The length check considers the inclusion of a 
- * newline character (`\n`) at the end of the string.
+ * (0-9, A-F, a-f).
  *
- * @param credential The credential string to be validated.
- * @param size The expected size of the credential, excluding the newline character.
+ * @param credential The null-terminated credential string to be validated.
+ * @param size The expected number of hexadecimal characters of the credential.
  *
  * @return true if the credential is valid (correct length and valid characters),
  *         false otherwise.
  *
- * @note The function assumes that a valid credential string ends with a newline 
- *       character. Therefore, the `size` parameter should be specified as 
- *       the length of the credential excluding the newline.
+ * @note The line terminator is stripped by the caller, so a valid credential
+ *       is exactly `size` characters long.
  */
-bool isCredential(String credential, int size)
+bool isCredential(const char *credential, size_t size)
 {
-  if(credential.length() != size + 1)  
+  if(strlen(credential) != size)
   {
     return false;
   }
   
-  int k = 0;
+  size_t k = 0;
   while (k < size && ((credential[k] >= '0' && credential[k] <= '9') || (credential[k] >= 'A' && credential[k] <= 'F') || (credential[k] >= 'a' && credential[k] <= 'f')))
   {
     k ++;
@@ -257,7 +389,7 @@ bool isCredential(String credential, int size)
  *
  * @return true if the Device EUI is valid, false otherwise.
  */
-bool isDevEUI(String devEUI)
+bool isDevEUI(const char *devEUI)
 {
   return isCredential(devEUI, 16);
 }
@@ -272,7 +404,7 @@ bool isDevEUI(String devEUI)
  *
  * @return true if the Application EUI is valid, false otherwise.
  */
-bool isAppEUI(String appEUI)
+bool isAppEUI(const char *appEUI)
 {
   return isCredential(appEUI, 16);
 }
@@ -287,7 +419,7 @@ bool isAppEUI(String appEUI)
  *
  * @return true if the Application Key is valid, false otherwise.
  */
-bool isAppKey(String appKey)
+bool isAppKey(const char *appKey)
 {
   return isCredential(appKey, 32);
 }
@@ -295,32 +427,57 @@ bool isAppKey(String appKey)
 /**
  * @brief Reads a value from Non-Volatile Memory.
  *
- * This function sends a command to read a value from the NVM at the specified address 
- * using the SerialLoRa interface. It processes the response to extract the value. 
- * If the response indicates an error, it returns 255.
+ * This function reads a single value with readNVMBlock().
  *
  * @param address The address in NVM from which to read the value.
  * 
  * @return The value read from NVM as an 8-bit unsigned integer. 
- *         Returns -1 in case of an error or if the response contains "+ERR".
+ *         Returns 255 in case of an error or if the response contains "+ERR".
  */
 uint8_t readNVM(uint8_t address)
 {
-  SerialLoRa.println("AT$NVM " + String(address));
-  delay(100);
-  String response = SerialLoRa.readString();
+  uint8_t value;
+  readNVMBlock(address, 1, &value);
+  return value;
+}
 
-  if(response.indexOf("+ERR") == -1)
+/**
+ * @brief Reads consecutive values from Non-Volatile Memory.
+ *
+ * This function reads the values one after the other, each read command
+ * being sent once the reply to the previous one has arrived: the modem
+ * handles one command at a time, and a late reply must not be taken for the
+ * reply to the next address. A reply is collected as soon as it arrives,
+ * instead of waiting a fixed delay and a full serial timeout for each address.
+ *
+ * @param address The address in NVM of the first value.
+ * @param count The number of consecutive values to read.
+ * @param values The array receiving the values. An entry is set to 255 if the
+ *        modem answered "+ERR" or did not answer in time.
+ *
+ * @return true if every value was read successfully, false otherwise.
+ */
+bool readNVMBlock(uint8_t address, uint8_t count, uint8_t values[])
+{
+  bool success = true;
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  for(uint8_t i = 0; i < count; i++)
   {
-    int startIndex = response.indexOf("=");
-    int endIndex = response.indexOf('\n', startIndex);
-    response = response.substring(startIndex  + 1, endIndex);
-  }
-  else
-  { 
-    response = "255";
+    SerialLoRa.print("AT$NVM ");
+    SerialLoRa.println(address + i);
+
+    values[i] = 255;
+    if(readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) == 0 || strstr(response, "+ERR") != NULL)
+    {
+      success = false;
+    }
+    else
+    {
+      const char *start = strchr(response, '=');
+      values[i] = start != NULL ? (uint8_t)strtoul(start + 1, NULL, 10) : 0;
+    }
   }
-  return response.toInt();
+  return success;
 }
 
 /**
@@ -339,14 +496,224 @@ uint8_t readNVM(uint8_t address)
  */
 bool writeNVM(uint8_t address, uint8_t value)
 {
-  SerialLoRa.println("AT$NVM " + String(address) + "," + String(value));
-  delay(100);
-  String response = SerialLoRa.readString();
+  SerialLoRa.print("AT$NVM ");
+  SerialLoRa.print(address);
+  SerialLoRa.print(",");
+  SerialLoRa.println(value);
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
   bool success = false;
 
-  if(response.indexOf("+OK") != -1)
+  if(readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) > 0 && strstr(response, "+OK") != NULL)
   {
     success = true;
   }
   return success;
 }
+
+/**
+ * @brief Reads one reply of the LoRa modem into a fixed-size buffer.
+ *
+ * This function collects the characters sent by the modem line by line and
+ * returns as soon as a line containing "+OK" or "+ERR" is terminated by a 
+ * carriage return or a line feed. Other lines, such as empty lines, are 
+ * skipped. Characters that do not fit in the buffer are discarded.
+ *
+ * @param response The buffer receiving the null-terminated reply.
+ * @param size The size of the buffer, including the null terminator.
+ * @param timeoutMs The maximum time to wait for the reply, in milliseconds.
+ *
+ * @return The length of the reply, or 0 if no reply arrived in time.
+ */
+size_t readModemResponse(char response[], size_t size, unsigned long timeoutMs)
+{
+  size_t length = 0;
+  unsigned long start = millis();
+
+  while(millis() - start < timeoutMs)
+  {
+    if(!SerialLoRa.available())
+    {
+      continue;
+    }
+
+    char inChar = (char)SerialLoRa.read();
+    if(inChar == '\r' || inChar == '\n')
+    {
+      response[length] = '\0';
+      if(strstr(response, "+OK") != NULL || strstr(response, "+ERR") != NULL)
+      {
+        return length;
+      }
+      length = 0;
+    }
+    else if(length < size - 1)
+    {
+      response[length++] = inChar;
+    }
+  }
+  response[0] = '\0';
+  return 0;
+}
+
+/**
+ * @brief Checks the copy of the credentials state kept in RAM.
+ *
+ * The copy lives in a section that is not cleared at startup, so it survives
+ * a warm reset (watchdog, reset button, firmware reboot) but not a power loss.
+ *
+ * @return true if the copy is valid and records initialized credentials.
+ */
+static bool credentialsCacheValid()
+{
+  return credentialsCache.magic == (CREDENTIALS_CACHE_MAGIC ^ Config::MAGIC_NUMBER)
+    && credentialsCache.check == ~credentialsCache.magic;
+}
+
+/**
+ * @brief Updates the copy of the credentials state kept in RAM.
+ *
+ * @param init true if the credentials are initialized, false to invalidate the copy.
+ */
+static void setCredentialsCache(bool init)
+{
+  credentialsCache.magic = init ? (CREDENTIALS_CACHE_MAGIC ^ Config::MAGIC_NUMBER) : 0;
+  credentialsCache.check = ~credentialsCache.magic;
+}
+
+/**
+ * @brief Checks and applies a bulk provisioning message.
+ *
+ * The message is only applied if its format, its CRC and every credential
+ * are valid: a rejected message leaves the credentials untouched.
+ *
+ * @param message The message following "AT+P=", <devEUI>,<appEUI>,<appKey>,<CRC>.
+ *
+ * @return NULL if the credentials are set and the configuration finished,
+ *         otherwise the reason of the rejection, "FORMAT" or "CRC".
+ */
+static const char *provision(const char *message)
+{
+  const char *devEuiText = message;
+  const char *appEuiText = devEuiText + DEVEUI_LENGTH + 1;
+  const char *appKeyText = appEuiText + APPEUI_LENGTH + 1;
+  const char *crcText = appKeyText + APPKEY_LENGTH + 1;
+  if(strlen(message) != PROVISIONING_LENGTH || appEuiText[-1] != ',' || appKeyText[-1] != ',' || crcText[-1] != ',')
+  {
+    return "FORMAT";
+  }
+
+  // Each field is checked in a copy, terminated where the next comma is
+  char devEuiValue[DEVEUI_LENGTH + 1];
+  char appEuiValue[APPEUI_LENGTH + 1];
+  char appKeyValue[APPKEY_LENGTH + 1];
+  char crcValue[PROVISIONING_CRC_LENGTH + 1];
+  memcpy(devEuiValue, devEuiText, DEVEUI_LENGTH);
+  devEuiValue[DEVEUI_LENGTH] = '\0';
+  memcpy(appEuiValue, appEuiText, APPEUI_LENGTH);
+  appEuiValue[APPEUI_LENGTH] = '\0';
+  memcpy(appKeyValue, appKeyText, APPKEY_LENGTH);
+  appKeyValue[APPKEY_LENGTH] = '\0';
+  memcpy(crcValue, crcText, PROVISIONING_CRC_LENGTH + 1);
+  if(!isDevEUI(devEuiValue) || !isAppEUI(appEuiValue) || !isAppKey(appKeyValue) || !isCredential(crcValue, PROVISIONING_CRC_LENGTH))
+  {
+    return "FORMAT";
+  }
+  if(crc16Ccitt((const uint8_t *)message, crcText - 1 - message) != strtoul(crcValue, NULL, 16))
+  {
+    return "CRC";
+  }
+
+  strcpy(devEui, devEuiValue);
+  strcpy(appEui, appEuiValue);
+  strcpy(appKey, appKeyValue);
+  bulkProvisioning = true;
+  configuration = true;
+  return NULL;
+}
+
+/**
+ * @brief Copies a string of the factory credentials record.
+ *
+ * @return true if the string is a valid credential of the given length.
+ */
+static bool copyFactoryCredential(char credential[], const volatile char source[], size_t length)
+{
+  for (size_t i = 0; i <= length; i++)
+  {
+    credential[i] = source[i];
+  }
+  return credential[length] == '\0' && isCredential(credential, length);
+}
+
+/**
+ * @brief Loads the credentials written in the firmware image.
+ *
+ * The record is only used if its marker, its CRC and every credential are
+ * valid. The credentials are left untouched otherwise.
+ *
+ * @return true if the credentials are loaded.
+ */
+bool loadFactoryCredentials()
+{
+  const volatile FactoryCredentials *record = FactoryRecord<Config::FACTORY_CREDENTIALS>::get();
+  char devEuiValue[DEVEUI_LENGTH + 1];
+  char appEuiValue[APPEUI_LENGTH + 1];
+  char appKeyValue[APPKEY_LENGTH + 1];
+  if (record == NULL || record->magic != FACTORY_CREDENTIALS_MAGIC
+    || !copyFactoryCredential(devEuiValue, record->devEui, DEVEUI_LENGTH)
+    || !copyFactoryCredential(appEuiValue, record->appEui, APPEUI_LENGTH)
+    || !copyFactoryCredential(appKeyValue, record->appKey, APPKEY_LENGTH))
+  {
+    return false;
+  }
+
+  uint16_t crc = crc16Ccitt((const uint8_t *)devEuiValue, DEVEUI_LENGTH);
+  crc = crc16Ccitt((const uint8_t *)appEuiValue, APPEUI_LENGTH, crc);
+  crc = crc16Ccitt((const uint8_t *)appKeyValue, APPKEY_LENGTH, crc);
+  if (crc != record->crc)
+  {
+    return false;
+  }
+
+  strcpy(devEui, devEuiValue);
+  strcpy(appEui, appEuiValue);
+  strcpy(appKey, appKeyValue);
+  return true;
+}
+
+/**
+ * @brief Locks the flash region of the factory credentials record.
+ *
+ * The NVM controller then rejects any erase or write of the region, until
+ * the next reset: the bootloader can still update the firmware. The
+ * region is left unlocked if it holds the history, written at run time.
+ *
+ * @return true if the region of the record is locked.
+ */
+bool lockFactoryCredentials()
+{
+  const volatile FactoryCredentials *record = FactoryRecord<Config::FACTORY_CREDENTIALS>::get();
+  if (record == NULL)
+  {
+    return false;
+  }
+
+  // The record may straddle two regions
+  uintptr_t first = (uintptr_t)record & ~(uintptr_t)(FLASH_LOCK_REGION_SIZE - 1);
+  uintptr_t last = ((uintptr_t)record + sizeof(FactoryCredentials) - 1) & ~(uintptr_t)(FLASH_LOCK_REGION_SIZE - 1);
+  if (isHistoryFlash(first, last + FLASH_LOCK_REGION_SIZE))
+  {
+    return false;
+  }
+  for (uintptr_t region = first; region <= last; region += FLASH_LOCK_REGION_SIZE)
+  {
+    NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK;
+    // The ADDR register holds the address in 16-bit words
+    NVMCTRL->ADDR.reg = region / 2;
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_LR;
+    while (NVMCTRL->INTFLAG.bit.READY == 0)
+    {
+    }
+  }
+  return true;
+}
@@ -7,11 +7,26 @@
  * This header file contains the implementation of the Driver Credentials functionality 
  * for managing device credentials in a LoRaWAN modem. It provides functions for 
  * initializing, reading, and writing credentials such as devEUI, appEUI, and appKey. 
- * The credentials are set and stored as strings via AT commands, allowing for easy 
- * configuration by the user.
+ * The credentials are set and stored as fixed-size character buffers via AT commands, 
+ * allowing for easy configuration by the user without any heap allocation.
+ * 
+ * A production tool (tools/provision.py) sets every credential at once with
+ * a single AT+P message protected by a CRC, and receives a single response:
+ * "+OK <configuration digest>" once the credentials are saved, or
+ * "+ERR <reason>" (FORMAT, CRC, NVM).
+ * 
+ * With Config::FACTORY_CREDENTIALS, the credentials are read at boot from
+ * the FactoryCredentials record of the firmware image, and neither the 
+ * console nor the NVM of the modem is used. The record is built with the
+ * values of Secret.hpp and a CRC left invalid on purpose, and
+ * tools/factory_images.py writes the credentials of each device of a
+ * manifest and their CRC into a copy of the image. The record is checked
+ * with its CRC-16/CCITT; if it is invalid, the node falls back to the
+ * console. Once loaded, its flash region is locked against writes.
  * 
  * Functions:
  * - init_Credentials: Initializes the credential input process.
+ * - readCommands: Processes the command lines received on the console.
  * - credentialsAlreadyInit: Checks if the credentials have already been initialized.
  * - processCommand: Processes incoming AT commands related to credentials.
  * - isCredential: Validates the format of the provided credentials.
@@ -19,7 +34,11 @@
  * - isAppEUI: Validates the appEUI format.
  * - isAppKey: Validates the appKey format.
  * - readNVM: Reads a value from Non-Volatile Memory (NVM).
+ * - readNVMBlock: Reads consecutive values from NVM, one reply at a time.
  * - writeNVM: Writes a value to Non-Volatile Memory (NVM).
+ * - readModemResponse: Reads a modem reply into a fixed-size buffer.
+ * - loadFactoryCredentials: Loads the credentials written in the firmware image.
+ * - lockFactoryCredentials: Locks the flash region of the factory credentials.
  */
 
 
@@ -28,21 +47,67 @@
 
 #include <Arduino.h>
 #include "Secret.hpp"
+#include "Config.hpp"
+#include "Console.hpp"
+
+#define DEVEUI_LENGTH 16
+#define APPEUI_LENGTH 16
+#define APPKEY_LENGTH 32
+#define COMMAND_MAX_LENGTH 80
+#define MODEM_RESPONSE_MAX_LENGTH 64
+#define CREDENTIALS_CACHE_MAGIC 0x43524544UL
+
+// Bulk provisioning message: AT+P=<devEUI>,<appEUI>,<appKey>,<CRC>, where CRC
+// is the CRC-16/CCITT of the text between "=" and the last comma, in 4 hex digits
+#define PROVISIONING_CRC_LENGTH 4
+#define PROVISIONING_LENGTH (DEVEUI_LENGTH + 1 + APPEUI_LENGTH + 1 + APPKEY_LENGTH + 1 + PROVISIONING_CRC_LENGTH)
+
+static_assert(5 + PROVISIONING_LENGTH <= COMMAND_MAX_LENGTH, "A provisioning message must fit COMMAND_MAX_LENGTH");
+static_assert(COMMAND_MAX_LENGTH <= CONSOLE_LINE_MAX_LENGTH, "A command must fit a console line");
+
+// Marker of the factory credentials record, "FCRD" in flash (little-endian)
+#define FACTORY_CREDENTIALS_MAGIC 0x44524346UL
+
+/**
+ * @brief Credentials record of the firmware image, located by tools/factory_images.py.
+ *
+ * The strings are null-terminated. The CRC-16/CCITT covers the devEUI,
+ * the appEUI and the appKey, without their terminators, in this order.
+ */
+struct FactoryCredentials
+{
+  uint32_t magic;
+  uint16_t crc;
+  char devEui[DEVEUI_LENGTH + 1];
+  char appEui[APPEUI_LENGTH + 1];
+  char appKey[APPKEY_LENGTH + 1];
+};
 
-#define MAGICNUMBER 92
+// Offsets relied upon by tools/factory_images.py
+static_assert(offsetof(FactoryCredentials, crc) == 4 && offsetof(FactoryCredentials, devEui) == 6
+  && offsetof(FactoryCredentials, appEui) == 23 && offsetof(FactoryCredentials, appKey) == 40,
+  "The layout of FactoryCredentials must match tools/factory_images.py");
+static_assert(sizeof(SECRET_DEV_EUI) == DEVEUI_LENGTH + 1 && sizeof(SECRET_APP_EUI) == APPEUI_LENGTH + 1
+  && sizeof(SECRET_APP_KEY) == APPKEY_LENGTH + 1, "The credentials of Secret.hpp have the wrong length");
 
-extern String appEui;
-extern String appKey;
-extern String devEui;
+extern char appEui[APPEUI_LENGTH + 1];
+extern char appKey[APPKEY_LENGTH + 1];
+extern char devEui[DEVEUI_LENGTH + 1];
+extern bool configuration;
 
 void init_Credentials();
+void readCommands();
 bool credentialsAlreadyInit();
-void processCommand(String command);
-bool isCredential(String credential, int size);
-bool isDevEUI(String devEUI);
-bool isAppEUI(String appEUI);
-bool isAppKey(String appKey);
+void processCommand(const char *command);
+bool isCredential(const char *credential, size_t size);
+bool isDevEUI(const char *devEUI);
+bool isAppEUI(const char *appEUI);
+bool isAppKey(const char *appKey);
 uint8_t readNVM(uint8_t address);
+bool readNVMBlock(uint8_t address, uint8_t count, uint8_t values[]);
 bool writeNVM(uint8_t address, uint8_t value);
+size_t readModemResponse(char response[], size_t size, unsigned long timeoutMs);
+bool loadFactoryCredentials();
+bool lockFactoryCredentials();
 
 #endif
\ No newline at end of file
@@ -16,8 +16,29 @@
  *   successful, it configures the modem for polling and data rate settings.
  * 
  * - send: Sends a packet of data over the LoRaWAN network. The function handles 
- *   transmission errors and retries based on the error count. If the error count 
- *   exceeds a threshold, it disconnects the device from the network.
+ *   transmission errors and retries based on the error count and the measured link 
+ *   quality. If the error count exceeds a threshold or the link is lost, it 
+ *   disconnects the device from the network. The data rate follows the link quality.
+ * 
+ * - modemSleep: Puts the modem in its low-power mode.
+ * 
+ * - modemWake: Wakes the modem up before a command and measures the wake latency. 
+ *   If the modem does not answer, it is recovered with a hardware reset, and the 
+ *   command is abandoned since the network session is lost.
+ * 
+ * - modemReset: Resets the modem with its reset pin and restarts it.
+ * 
+ * - scheduleModemSleep: Puts the modem to sleep once it has been idle for 
+ *   MODEM_SLEEP_DELAY_MS, using a task of the scheduler.
+ * 
+ * - openReceiveWindow: Switches the modem to class C for a while, so that 
+ *   downlinks are received within seconds instead of after the next uplink.
+ * 
+ * - closeReceiveWindow: Switches the modem back to class A at the end of a window.
+ * 
+ * The downlink mode is selected by Config::DEVICE_CLASS: class A only, or 
+ * class C permanently. In class A, class C windows can be opened periodically 
+ * (Config::CLASS_C_WINDOW_PERIOD_MS) or on request of a downlink command.
  * 
  * Note:
  * The LoRaModem library must be installed and included in the project. The MKR WAN 1310 
@@ -25,6 +46,8 @@
  */
 
 #include "Driver_LoRaWan.hpp"
+#include "Downlink.hpp"
+#include "Health.hpp"
 
 // LoRa modem object for handling communication
 LoRaModem modem;
@@ -35,79 +58,421 @@ bool connected = false;
 // Tracks the number of consecutive transmission errors.
 int err_count = 0;
 
+// Time of the first successful uplink since the boot, in milliseconds (0 until then).
+unsigned long firstUplinkTime = 0;
+
+// Indicates whether the modem is in its low-power mode.
+bool modemAsleep = false;
+
+// Last and maximum time taken by the modem to answer after a wake up, in milliseconds.
+unsigned long modemWakeLatency = 0;
+unsigned long modemWakeLatencyMax = 0;
+
+// Number of hardware resets used to recover the modem.
+unsigned int modemResetCount = 0;
+
+// Indicates that the modem did not restart after its last reset.
+bool modemResetFailed = false;
+
+// Scheduler task putting the modem to sleep, SCHEDULER_NO_TASK if none is pending.
+static int sleepTask = SCHEDULER_NO_TASK;
+
+// Data rate of the uplinks, adapted to the link quality.
+uint8_t dataRate = Config::DATA_RATE;
+
+// Indicates whether the modem listens in class C, permanently or during a window.
+bool receiveWindowOpen = false;
+
+// Duration of the last class C window opened by a downlink command, in milliseconds.
+unsigned long commandWindowMs = 0;
+
+// Scheduler tasks polling the downlinks and closing the current class C window.
+static int downlinkTask = SCHEDULER_NO_TASK;
+static int closeWindowTask = SCHEDULER_NO_TASK;
+
+static bool openDownlinkCommand(const uint8_t data[], size_t length);
+static void periodicReceiveWindow();
+static void pollDownlinkTask();
+
 /**
  * @brief Initializes the LoRaWAN modem and sets the frequency plan to EU868.
  * 
  * This function starts the LoRaWAN modem and ensures the device is ready to communicate 
- * over the EU868 frequency band. If the modem fails to start, the system halts in an infinite loop.
+ * over the EU868 frequency band. If the modem fails to start, the system halts in an infinite loop,
+ * still draining the console so that the error reaches a host connecting later.
  */
 void init_LoRaWan()
 {
   if (!modem.begin(EU868)) 
   {
-    Serial.println("Failed to start module");
+    console.println("Failed to start module");
     while (1) 
     {
+      updateConsole();
       delay(1000);
     }
   }
 
-  Serial.println("Module started");
+  console.println("Module started");
+
+  registerDownlinkHandler(DOWNLINK_CMD_OPEN_WINDOW, openDownlinkCommand);
 }
 
 /**
  * @brief Attempts to connect to the LoRaWAN network using OTAA.
  * 
  * This function tries to connect to the LoRaWAN network using the provided AppEUI, AppKey, and DevEUI credentials. 
- * If the connection is successful, it adjusts the polling interval and data rate, and resets the error counter. 
- * Otherwise, the connection remains inactive.
+ * If the connection is successful, it adjusts the polling interval and data rate, resets the error counter 
+ * and configures the downlink mode. The configuration digest is then queued, so that the network server 
+ * sees the configuration of the node with its first data. Otherwise, the connection remains inactive.
  */
 void connect()
 {
-  Serial.println("trying to connect");
+  if (!modemWake())
+  {
+    return;
+  }
+  console.println("trying to connect");
+  profileStart(PHASE_JOIN);
   
   int ret = modem.joinOTAA(appEui, appKey, devEui);
   
   if (ret)
   {
     connected = true;
-    modem.minPollInterval(60);
-    modem.dataRate(5);
+    profileEnd(PHASE_JOIN);
+    modem.minPollInterval(Config::MIN_POLL_INTERVAL_S);
+    dataRate = Config::DATA_RATE;
+    modem.dataRate(dataRate);
     delay(100);
     err_count = 0;
+    resetLinkQuality();
+    resetChannelMask();
+    queueConfigDigest();
+
+    if (Config::DEVICE_CLASS == 'C')
+    {
+      openReceiveWindow(0);
+    }
+    else if (Config::CLASS_C_WINDOW_PERIOD_MS > 0)
+    {
+      static int windowTask = SCHEDULER_NO_TASK;
+      if (windowTask == SCHEDULER_NO_TASK)
+      {
+        windowTask = addTask(periodicReceiveWindow, Config::CLASS_C_WINDOW_PERIOD_MS, Config::CLASS_C_WINDOW_PERIOD_MS);
+      }
+    }
   }
+  scheduleModemSleep();
 }
 
 /**
  * @brief Sends a message over the LoRaWAN network.
  * 
  * This function sends a message (given as a char array) of a specific size over the LoRaWAN network. 
- * If the transmission fails, it increments the error count. If more than 50 consecutive transmission errors occur, 
- * the connection is considered lost and `connected` is set to `false`.
+ * If the transmission fails, it increments the error count. If more than Config::MAX_TX_ERRORS consecutive transmission errors occur, 
+ * or if the average success rate shows the link is lost, the connection is considered lost and `connected` is set to `false`.
+ * Every Config::LINK_CHECK_PERIOD uplinks, a LinkCheckReq is added to the uplink and the data rate is adapted to its answer,
+ * the configuration digest being queued again when it changes.
+ * The channel mask of the uplink is chosen by the channel statistics, see Channels.hpp.
+ * The first successful uplink ends the boot profile, which is then reported.
+ * The modem is woken up before the transmission and put back to sleep once idle. 
+ * Nothing is sent if the modem had to be reset to wake up: the device joins again first.
+ * A downlink received in the RX windows of the uplink is dispatched.
  * 
  * @param msg The message to be sent as a char array.
  * @param size The size of the message to be sent.
+ * @param port The application port of the message.
+ *
+ * @return true if the message has been transmitted, false otherwise.
  */
-void send(char msg[], int size)
+bool send(char msg[], int size, uint8_t port)
 {
   int err = 0;
+  if (!modemWake())
+  {
+    return false;
+  }
+  profileStart(PHASE_FIRST_TX);
+  bool linkCheck = linkCheckDue();
+  if (linkCheck)
+  {
+    requestLinkCheck();
+  }
+  channelBeforeUplink();
+  modem.setPort(port);
   modem.beginPacket();
   modem.write(msg, size);
   err = modem.endPacket(true);
+  recordTxResult(err > 0);
+  channelAfterUplink(err > 0);
 
   if (err <= 0)
   {
-    Serial.println("erreur de transmission");
+    console.println("erreur de transmission");
     err_count ++;
-    if(err_count>50)
+    if(err_count>Config::MAX_TX_ERRORS || linkLost())
     {
       connected = false;
     }
-      delay(1000);
+      delay(Config::TX_ERROR_BACKOFF_MS);
   }
   else
   {
-    Serial.println("transmission OK");
+    console.println("transmission OK");
+    pollDownlink();
+    if (linkCheck && readLinkCheck())
+    {
+      uint8_t newDataRate = linkDataRate(dataRate);
+      if (newDataRate != dataRate && modem.dataRate(newDataRate))
+      {
+        dataRate = newDataRate;
+        queueConfigDigest();
+      }
+    }
     err_count = 0;
+    if(firstUplinkTime == 0)
+    {
+      firstUplinkTime = millis();
+      profileEnd(PHASE_FIRST_TX);
+      printBootProfile();
+    }
+  }
+  scheduleModemSleep();
+  return err > 0;
+}
+
+/**
+ * @brief Puts the modem in its low-power mode.
+ *
+ * Does nothing if Config::MODEM_POWER_SAVE is disabled or if the modem is
+ * already asleep. The modem is expected to have completed its RX windows:
+ * endPacket() and joinOTAA() only return once they are closed.
+ */
+void modemSleep()
+{
+  sleepTask = SCHEDULER_NO_TASK;
+  if (!Config::MODEM_POWER_SAVE || modemAsleep)
+  {
+    return;
+  }
+
+  SerialLoRa.println(MODEM_SLEEP_COMMAND);
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  if (readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) > 0 && strstr(response, "+OK") != NULL)
+  {
+    modemAsleep = true;
+  }
+}
+
+/**
+ * @brief Wakes the modem up and waits until it answers.
+ *
+ * The modem is woken up by the characters of an "AT" command, which is
+ * repeated until the modem answers or Config::MODEM_WAKE_ATTEMPTS attempts
+ * have failed. The wake latency is recorded and printed. If the modem never
+ * answers, it is recovered with modemReset(). A modem whose last restart 
+ * failed is reset again.
+ *
+ * @return true if the modem is awake with its network session, false if it 
+ *         had to be reset: the caller must not go on with its command, the
+ *         device has to join again.
+ */
+bool modemWake()
+{
+  if (sleepTask != SCHEDULER_NO_TASK)
+  {
+    stopTask(sleepTask);
+    sleepTask = SCHEDULER_NO_TASK;
+  }
+  if (modemResetFailed)
+  {
+    modemReset();
+    return false;
+  }
+  if (!modemAsleep)
+  {
+    return true;
+  }
+
+  unsigned long start = millis();
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  for (int attempt = 0; attempt < Config::MODEM_WAKE_ATTEMPTS; attempt++)
+  {
+    SerialLoRa.println("AT");
+    if (readModemResponse(response, sizeof(response), Config::MODEM_WAKE_TIMEOUT_MS) > 0)
+    {
+      modemAsleep = false;
+      modemWakeLatency = millis() - start;
+      if (modemWakeLatency > modemWakeLatencyMax)
+      {
+        modemWakeLatencyMax = modemWakeLatency;
+      }
+      console.print("Modem wake latency (ms): ");
+      console.println(modemWakeLatency);
+      return true;
+    }
+  }
+
+  console.println("Modem not answering, resetting it");
+  modemReset();
+  return false;
+}
+
+/**
+ * @brief Resets the modem with its reset pin and restarts it.
+ *
+ * modem.begin() pulses the LORA_RESET pin before configuring the band. The
+ * network session is lost with the reset, so the device has to join again, 
+ * and the modem is back in class A and awake. A failed restart is recorded 
+ * in modemResetFailed, and the next modemWake() resets the modem again.
+ */
+void modemReset()
+{
+  modemResetCount ++;
+  connected = false;
+  if (receiveWindowOpen)
+  {
+    stopTask(downlinkTask);
+    downlinkTask = SCHEDULER_NO_TASK;
+    receiveWindowOpen = false;
+  }
+  modemAsleep = false;
+  modemResetFailed = !modem.begin(EU868);
+  if (modemResetFailed)
+  {
+    console.println("Failed to restart module");
   }
 }
+
+/**
+ * @brief Puts the modem to sleep once it has been idle for MODEM_SLEEP_DELAY_MS.
+ *
+ * A pending sleep is postponed by each call, and cancelled by modemWake(). 
+ * The modem does not sleep while a class C window is open.
+ */
+void scheduleModemSleep()
+{
+  if (!Config::MODEM_POWER_SAVE || receiveWindowOpen)
+  {
+    return;
+  }
+
+  if (sleepTask != SCHEDULER_NO_TASK)
+  {
+    rescheduleTask(sleepTask, Config::MODEM_SLEEP_DELAY_MS);
+  }
+  else
+  {
+    sleepTask = addTask(modemSleep, Config::MODEM_SLEEP_DELAY_MS, 0);
+  }
+}
+
+/**
+ * @brief Switches the modem to class C for a while.
+ *
+ * While the window is open, the modem listens continuously and the received
+ * downlinks are polled every Config::DOWNLINK_POLL_PERIOD_MS, so commands 
+ * reach the node within seconds. Opening a window that is already open 
+ * extends it.
+ *
+ * @param durationMs The duration of the window in milliseconds, 0 for a 
+ *        permanent class C.
+ */
+void openReceiveWindow(unsigned long durationMs)
+{
+  if (!receiveWindowOpen)
+  {
+    if (!modemWake() || !modem.configureClass(CLASS_C))
+    {
+      console.println("Failed to switch to class C");
+      scheduleModemSleep();
+      return;
+    }
+    receiveWindowOpen = true;
+    downlinkTask = addTask(pollDownlinkTask, 0, Config::DOWNLINK_POLL_PERIOD_MS);
+  }
+
+  if (durationMs > 0)
+  {
+    if (closeWindowTask != SCHEDULER_NO_TASK)
+    {
+      rescheduleTask(closeWindowTask, durationMs);
+    }
+    else
+    {
+      closeWindowTask = addTask(closeReceiveWindow, durationMs, 0);
+    }
+  }
+}
+
+/**
+ * @brief Switches the modem back to class A at the end of a window.
+ *
+ * Does nothing if the device is configured in class C permanently.
+ */
+void closeReceiveWindow()
+{
+  closeWindowTask = SCHEDULER_NO_TASK;
+  if (!receiveWindowOpen || Config::DEVICE_CLASS == 'C')
+  {
+    return;
+  }
+
+  stopTask(downlinkTask);
+  downlinkTask = SCHEDULER_NO_TASK;
+  modem.configureClass(CLASS_A);
+  receiveWindowOpen = false;
+  scheduleModemSleep();
+}
+
+/**
+ * @brief Downlink command opening a class C window.
+ *
+ * A duration of 0 closes the window instead: a downlink never switches the
+ * node to a permanent class C, which would keep the modem awake.
+ *
+ * @param data The duration of the window in seconds, as a big-endian 16-bit 
+ *        value: 1 to 65535 opens or extends the window, 0 closes it.
+ * @param length The length of the data, 2 bytes.
+ *
+ * @return true if the command is valid.
+ */
+static bool openDownlinkCommand(const uint8_t data[], size_t length)
+{
+  if (length != 2)
+  {
+    return false;
+  }
+  commandWindowMs = ((unsigned long)data[0] << 8 | data[1]) * 1000UL;
+  if (commandWindowMs == 0)
+  {
+    if (closeWindowTask != SCHEDULER_NO_TASK)
+    {
+      stopTask(closeWindowTask);
+    }
+    closeReceiveWindow();
+    return true;
+  }
+  openReceiveWindow(commandWindowMs);
+  return true;
+}
+
+/**
+ * @brief Task opening the periodic class C window.
+ */
+static void periodicReceiveWindow()
+{
+  if (connected)
+  {
+    openReceiveWindow(Config::CLASS_C_WINDOW_DURATION_MS);
+  }
+}
+
+/**
+ * @brief Task polling the downlinks while a class C window is open.
+ */
+static void pollDownlinkTask()
+{
+  pollDownlink();
+}
\ No newline at end of file
@@ -16,8 +16,29 @@
  *   successful, it configures the modem for polling and data rate settings.
  * 
  * - send: Sends a packet of data over the LoRaWAN network. The function handles 
- *   transmission errors and retries based on the error count. If the error count 
- *   exceeds a threshold, it disconnects the device from the network.
+ *   transmission errors and retries based on the error count and the measured link 
+ *   quality. If the error count exceeds a threshold or the link is lost, it 
+ *   disconnects the device from the network. The data rate follows the link quality.
+ * 
+ * - modemSleep: Puts the modem in its low-power mode.
+ * 
+ * - modemWake: Wakes the modem up before a command and measures the wake latency. 
+ *   If the modem does not answer, it is recovered with a hardware reset, and the 
+ *   command is abandoned since the network session is lost.
+ * 
+ * - modemReset: Resets the modem with its reset pin and restarts it.
+ * 
+ * - scheduleModemSleep: Puts the modem to sleep once it has been idle for 
+ *   MODEM_SLEEP_DELAY_MS, using a task of the scheduler.
+ * 
+ * - openReceiveWindow: Switches the modem to class C for a while, so that 
+ *   downlinks are received within seconds instead of after the next uplink.
+ * 
+ * - closeReceiveWindow: Switches the modem back to class A at the end of a window.
+ * 
+ * The downlink mode is selected by Config::DEVICE_CLASS: class A only, or 
+ * class C permanently. In class A, class C windows can be opened periodically 
+ * (Config::CLASS_C_WINDOW_PERIOD_MS) or on request of a downlink command.
  * 
  * Note:
  * The LoRaModem library must be installed and included in the project. The MKR WAN 1310 
@@ -29,13 +50,36 @@
 
 #include <MKRWAN.h>
 #include "Driver_Credentials.hpp"
+#include "Profiler.hpp"
+#include "Scheduler.hpp"
+#include "LinkQuality.hpp"
+#include "Channels.hpp"
+
+// AT command of the modem firmware entering its low-power mode, 
+// any character received on its UART wakes it up.
+#define MODEM_SLEEP_COMMAND "AT$SLEEP"
 
 extern LoRaModem modem;
 extern bool connected;
 extern int err_count;
+extern unsigned long firstUplinkTime;
+extern bool modemAsleep;
+extern unsigned long modemWakeLatency;
+extern unsigned long modemWakeLatencyMax;
+extern unsigned int modemResetCount;
+extern bool modemResetFailed;
+extern bool receiveWindowOpen;
+extern uint8_t dataRate;
+extern unsigned long commandWindowMs;
 
 void init_LoRaWan();
 void connect();
-void send(char msg[], int size);
+bool send(char msg[], int size, uint8_t port = Config::UPLINK_PORT);
+void modemSleep();
+bool modemWake();
+void modemReset();
+void scheduleModemSleep();
+void openReceiveWindow(unsigned long durationMs);
+void closeReceiveWindow();
 
 #endif
\ No newline at end of file
@@ -10,31 +10,227 @@
  * Functions:
  * - init_SHT31: Initializes the SHT31 sensor by checking if it is properly 
  *   connected to the I2C bus. If the sensor is not found, it prints an error 
- *   message to the Serial monitor and enters an infinite loop.
+ *   message to the console and enters an infinite loop.
+ * 
+ * - readSHT31Raw: Reads the raw temperature and humidity words of a measurement,
+ *   with a flag for each word whose CRC is valid.
+ * 
+ * - sht31Command: Sends a 16-bit command to the sensor.
+ * 
+ * - recoverSHT31: Clears the I2C bus and resets the sensor.
  * 
  * Note:
  * The Adafruit_SHT31 library must be installed and included in the project. 
- * The sensor communicates via I2C at address 0x44.
+ * The sensor communicates via I2C at address Config::SHT31_ADDRESS (0x44 by default).
  */
 
 #include "Driver_SHT31.hpp"
+#include "Heater.hpp"
 
 // Creates an instance of the Adafruit_SHT31 sensor object.
 Adafruit_SHT31 sht31 = Adafruit_SHT31();
 
+uint16_t sht31FailureCount = 0;
+uint8_t i2cBusClearCount = 0;
+uint8_t sht31ResetCount = 0;
+
+// Failed measurements since the last successful one
+static uint8_t consecutiveFailures = 0;
+
+/**
+ * @brief Rounds a positive or negative double to the nearest integer, halves away from zero.
+ */
+constexpr int32_t sht31RoundReference(double value)
+{
+  return value >= 0 ? (int32_t)(value + 0.5) : -(int32_t)(-value + 0.5);
+}
+
+/**
+ * @brief Checks the conversions of the raw words first to last against the floating-point formulas.
+ */
+constexpr bool sht31CheckConversions(uint32_t first, uint32_t last)
+{
+  return first == last
+    ? sht31Temperature(first) == sht31RoundReference(-4500.0 + 17500.0 * first / 65535.0)
+      && sht31Humidity(first) == sht31RoundReference(10000.0 * first / 65535.0)
+    : sht31CheckConversions(first, (first + last) / 2) && sht31CheckConversions((first + last) / 2 + 1, last);
+}
+
+static_assert(sht31Crc(0xBE, 0xEF) == 0x92, "CRC-8 of 0xBEEF must be 0x92 (SHT3x datasheet)");
+static_assert(sht31CheckConversions(0, 65535), "The integer conversions must match the rounded floating-point formulas for every raw value");
+
 /**
  * @brief Initializes the SHT31 temperature and humidity sensor.
  * 
  * This function initializes the SHT31 sensor by attempting to establish 
  * communication over the I2C bus. It checks if the sensor is connected 
- * at the address 0x44. If the sensor is not found, an error message is 
- * printed to the Serial monitor and the system enters an infinite loop.
+ * at the address Config::SHT31_ADDRESS. If the sensor is not found, an error message is 
+ * printed to the console and the system enters an infinite loop, still
+ * draining the console so that the message reaches a host connecting later.
  */
 void init_SHT31()
 {
-  if (! sht31.begin(0x44)) 
+  if (! sht31.begin(Config::SHT31_ADDRESS)) 
   {   
-    Serial.println("Couldn't find SHT31");
-    while (1) delay(1);
+    console.println("Couldn't find SHT31");
+    while (1) 
+    {
+      updateConsole();
+      delay(1);
+    }
+  }
+}
+
+/**
+ * @brief Counts a failed measurement, and recovers the bus after SHT31_MAX_FAILURES in a row.
+ * 
+ * @return 0, the flags of a failed measurement.
+ */
+static uint8_t measurementFailed()
+{
+  if (sht31FailureCount < 0xFFFF)
+  {
+    sht31FailureCount ++;
+  }
+  if (++ consecutiveFailures >= Config::SHT31_MAX_FAILURES)
+  {
+    recoverSHT31();
+    consecutiveFailures = 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads the raw temperature and humidity words of a measurement.
+ * 
+ * Starts a single shot measurement, waits for its completion, then reads 
+ * the two words and checks their CRC. The words are returned even if their
+ * CRC is wrong, the caller decides what to do with them. A measurement
+ * which is not acknowledged or read back counts as a failure, and the bus
+ * is recovered after Config::SHT31_MAX_FAILURES failures in a row.
+ * 
+ * @param temperature Receives the raw temperature word, 0 if the measurement failed.
+ * @param humidity Receives the raw humidity word, 0 if the measurement failed.
+ * 
+ * @return The flags of the valid words, SHT31_TEMPERATURE_VALID and 
+ *         SHT31_HUMIDITY_VALID, 0 if the measurement failed.
+ */
+uint8_t readSHT31Raw(uint16_t &temperature, uint16_t &humidity)
+{
+  temperature = 0;
+  humidity = 0;
+
+  if (!sht31Command(SHT31_MEASURE_COMMAND))
+  {
+    return measurementFailed();
+  }
+  delay(SHT31_MEASURE_DURATION_MS);
+
+  uint8_t data[6];
+  if (Wire.requestFrom(Config::SHT31_ADDRESS, sizeof(data)) != sizeof(data))
+  {
+    return measurementFailed();
+  }
+  for (size_t i = 0; i < sizeof(data); i++)
+  {
+    data[i] = Wire.read();
+  }
+  consecutiveFailures = 0;
+
+  temperature = (uint16_t)data[0] << 8 | data[1];
+  humidity = (uint16_t)data[3] << 8 | data[4];
+  return (sht31Crc(data[0], data[1]) == data[2] ? SHT31_TEMPERATURE_VALID : 0)
+    | (sht31Crc(data[3], data[4]) == data[5] ? SHT31_HUMIDITY_VALID : 0);
+}
+
+/**
+ * @brief Sends a 16-bit command to the sensor, most significant byte first.
+ * 
+ * @param command The command, e.g. SHT31_HEATER_ON_COMMAND.
+ * 
+ * @return true if the sensor acknowledged the command.
+ */
+bool sht31Command(uint16_t command)
+{
+  Wire.beginTransmission(Config::SHT31_ADDRESS);
+  Wire.write(command >> 8);
+  Wire.write(command & 0xFF);
+  return Wire.endTransmission() == 0;
+}
+
+/**
+ * @brief Drives a line of the I2C bus low.
+ *
+ * INPUT_PULLUP leaves the output latch of the pin high to select the
+ * pull-up: it is cleared before the pin becomes an output, so that the
+ * line is never driven high, even for the few cycles before digitalWrite().
+ */
+static void driveLow(uint8_t pin)
+{
+  PORT->Group[g_APinDescription[pin].ulPort].OUTCLR.reg = 1ul << g_APinDescription[pin].ulPin;
+  pinMode(pin, OUTPUT);
+}
+
+/**
+ * @brief Releases an I2C bus held by a slave and generates a STOP condition.
+ * 
+ * A slave reset or interrupted in the middle of a read may hold SDA low
+ * while it waits for the clock of the rest of its byte. Up to nine clock
+ * pulses are generated on SCL by hand until it releases SDA, then a STOP
+ * condition brings every slave back to idle. The lines are driven as open
+ * drain: pulled low as outputs, released as inputs.
+ */
+static void clearI2CBus()
+{
+  Wire.end();
+  pinMode(PIN_WIRE_SDA, INPUT_PULLUP);
+  pinMode(PIN_WIRE_SCL, INPUT_PULLUP);
+  if (digitalRead(PIN_WIRE_SDA) == LOW && i2cBusClearCount < 255)
+  {
+    i2cBusClearCount ++;
+  }
+
+  for (int i = 0; i < I2C_CLEAR_CLOCKS && digitalRead(PIN_WIRE_SDA) == LOW; i++)
+  {
+    driveLow(PIN_WIRE_SCL);
+    delayMicroseconds(I2C_CLEAR_HALF_PERIOD_US);
+    pinMode(PIN_WIRE_SCL, INPUT_PULLUP);
+    delayMicroseconds(I2C_CLEAR_HALF_PERIOD_US);
+  }
+
+  // STOP: SDA rises while SCL is high
+  driveLow(PIN_WIRE_SCL);
+  driveLow(PIN_WIRE_SDA);
+  delayMicroseconds(I2C_CLEAR_HALF_PERIOD_US);
+  pinMode(PIN_WIRE_SCL, INPUT_PULLUP);
+  delayMicroseconds(I2C_CLEAR_HALF_PERIOD_US);
+  pinMode(PIN_WIRE_SDA, INPUT_PULLUP);
+  delayMicroseconds(I2C_CLEAR_HALF_PERIOD_US);
+
+  Wire.begin();
+}
+
+/**
+ * @brief Clears the I2C bus and resets the sensor, without rebooting the node.
+ * 
+ * After the bus is cleared, the sensor is reset with its soft reset 
+ * command, or with an I2C general call reset if it does not acknowledge 
+ * it. The reset also switches the heater off, which the heater policy is
+ * told with heaterReset().
+ */
+void recoverSHT31()
+{
+  clearI2CBus();
+  if (!sht31Command(SHT31_SOFT_RESET_COMMAND))
+  {
+    Wire.beginTransmission(I2C_GENERAL_CALL_ADDRESS);
+    Wire.write(I2C_GENERAL_CALL_RESET);
+    Wire.endTransmission();
+  }
+  delay(SHT31_RESET_DURATION_MS);
+  heaterReset();
+  if (sht31ResetCount < 255)
+  {
+    sht31ResetCount ++;
   }
 }
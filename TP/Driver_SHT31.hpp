@@ -7,14 +7,36 @@
  * the initialization function for setting up communication with the 
  * SHT31 sensor.
  * 
+ * The measurements bypass the float conversions of the library: the raw
+ * words are read over I2C with their CRC flags, transmitted as is, and
+ * converted to hundredths with integer arithmetic only where the node needs
+ * the values (history, derived metrics):
+ *   T = -45 + 175 * raw / 65535 degrees C, RH = 100 * raw / 65535 %
+ * The conversions are checked at compile time against the floating-point
+ * formulas, rounded to the nearest hundredth, for every raw value (see
+ * Driver_SHT31.cpp).
+ * 
  * Functions:
  * - init_SHT31: Initializes the SHT31 sensor by checking if it is properly 
  *   connected to the I2C bus. If the sensor is not found, it prints an error 
- *   message to the Serial monitor and enters an infinite loop.
+ *   message to the console and enters an infinite loop.
+ * 
+ * - readSHT31Raw: Reads the raw temperature and humidity words of a measurement,
+ *   with a flag for each word whose CRC is valid.
+ * 
+ * - sht31Command: Sends a 16-bit command to the sensor, e.g. to switch its
+ *   heater on or off.
+ * 
+ * - recoverSHT31: Clears a stuck I2C bus and resets the sensor, called by 
+ *   readSHT31Raw after Config::SHT31_MAX_FAILURES failed measurements in a row.
+ * 
+ * - sht31Crc: CRC-8 of a word (polynomial 0x31, initial value 0xFF).
+ * 
+ * - sht31Temperature, sht31Humidity: Convert the raw words to hundredths.
  * 
  * Note:
  * The Adafruit_SHT31 library must be installed and included in the project. 
- * The sensor communicates via I2C at address 0x44.
+ * The sensor communicates via I2C at address Config::SHT31_ADDRESS (0x44 by default).
  */
 
 #ifndef HPP__DRIVERSHT31__HPP
@@ -22,9 +44,75 @@
 
 #include <Wire.h>
 #include <Adafruit_SHT31.h>
+#include "Config.hpp"
+#include "Console.hpp"
+#include "FixedPoint.hpp"
+
+// Single shot measurement, high repeatability, without clock stretching,
+// and its maximum duration
+#define SHT31_MEASURE_COMMAND 0x2400
+#define SHT31_MEASURE_DURATION_MS 16
+
+// Internal heater, switched off by the soft reset of init_SHT31()
+#define SHT31_HEATER_ON_COMMAND 0x306D
+#define SHT31_HEATER_OFF_COMMAND 0x3066
+
+// Soft reset of the sensor, its maximum duration, and the I2C general call
+// reset, answered by the sensor even when its own command is not
+#define SHT31_SOFT_RESET_COMMAND 0x30A2
+#define SHT31_RESET_DURATION_MS 2
+#define I2C_GENERAL_CALL_ADDRESS 0x00
+#define I2C_GENERAL_CALL_RESET 0x06
+
+// Clock pulses generated to release SDA, one byte and its acknowledge, 
+// at 100 kHz
+#define I2C_CLEAR_CLOCKS 9
+#define I2C_CLEAR_HALF_PERIOD_US 5
+
+// Flags of the words read with a valid CRC
+#define SHT31_TEMPERATURE_VALID 0x01
+#define SHT31_HUMIDITY_VALID 0x02
 
 extern Adafruit_SHT31 sht31;
+extern uint16_t sht31FailureCount;
+extern uint8_t i2cBusClearCount;
+extern uint8_t sht31ResetCount;
 
 void init_SHT31();
+uint8_t readSHT31Raw(uint16_t &temperature, uint16_t &humidity);
+bool sht31Command(uint16_t command);
+void recoverSHT31();
+
+/**
+ * @brief Shifts the bits of a byte through the CRC-8 of the SHT31.
+ */
+constexpr uint8_t sht31CrcBits(uint8_t crc, uint8_t bits)
+{
+  return bits == 0 ? crc : sht31CrcBits(crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1), bits - 1);
+}
+
+/**
+ * @brief Returns the CRC-8 of a word (polynomial 0x31, initial value 0xFF).
+ */
+constexpr uint8_t sht31Crc(uint8_t msb, uint8_t lsb)
+{
+  return sht31CrcBits(sht31CrcBits(0xFF ^ msb, 8) ^ lsb, 8);
+}
+
+/**
+ * @brief Converts a raw temperature word to hundredths of degree C.
+ */
+constexpr int16_t sht31Temperature(uint16_t raw)
+{
+  return (int16_t)(divRound(17500L * raw, 65535) - 4500);
+}
+
+/**
+ * @brief Converts a raw humidity word to hundredths of %.
+ */
+constexpr int16_t sht31Humidity(uint16_t raw)
+{
+  return (int16_t)divRound(10000L * raw, 65535);
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+ * File: FixedPoint.hpp
+ *
+ * Description:
+ * This header file provides the fixed-point arithmetic of the firmware.
+ * The SAMD21 has no FPU: every float operation is a call to the soft-float
+ * library, so the data path works on scaled integers instead.
+ *
+ * A Qn value is a real value multiplied by 2^n and stored in a signed
+ * integer; the number of fractional bits is given with each operation.
+ * Values in hundredths are integers scaled by 100.
+ *
+ * Functions:
+ * - qFromInt: Converts an integer to Qn.
+ * - qRound: Rounds a Qn value to the nearest integer.
+ * - qMul: Multiplies two Qn values.
+ * - qDiv: Divides two Qn values.
+ * - qEwma: Updates an exponentially weighted moving average.
+ * - divRound: Divides two integers, rounding to the nearest.
+ *
+ * Note:
+ * The Arduino SAMD core compiles with -std=gnu++11, so every function
+ * is a single return statement. Right shifts of negative values are
+ * arithmetic with GCC.
+ */
+
+#ifndef HPP__FIXEDPOINT__HPP
+#define HPP__FIXEDPOINT__HPP
+
+#include <stdint.h>
+
+// Value in hundredths of a failed reading or of a metric which cannot be computed
+#define INVALID_HUNDREDTHS ((int16_t)0x8000)
+
+/**
+ * @brief Converts an integer to Qn.
+ */
+constexpr int32_t qFromInt(int32_t value, uint8_t bits)
+{
+  return value * ((int32_t)1 << bits);
+}
+
+/**
+ * @brief Rounds a Qn value to the nearest integer, halves rounded up.
+ */
+constexpr int32_t qRound(int32_t value, uint8_t bits)
+{
+  return (value + ((int32_t)1 << bits >> 1)) >> bits;
+}
+
+/**
+ * @brief Multiplies two Qn values, rounding the result to the nearest.
+ */
+constexpr int32_t qMul(int32_t a, int32_t b, uint8_t bits)
+{
+  return (int32_t)(((int64_t)a * b + ((int64_t)1 << bits >> 1)) >> bits);
+}
+
+/**
+ * @brief Divides two Qn values, truncating the result towards zero.
+ */
+constexpr int32_t qDiv(int32_t a, int32_t b, uint8_t bits)
+{
+  return (int32_t)((int64_t)a * ((int64_t)1 << bits) / b);
+}
+
+/**
+ * @brief Updates an exponentially weighted moving average.
+ *
+ *   average += (sample - average) / 2^shift
+ *
+ * @param average The average, in any Qn format.
+ * @param sample The new sample, in the same format.
+ * @param shift The weight of the sample, 1 / 2^shift.
+ */
+constexpr int32_t qEwma(int32_t average, int32_t sample, uint8_t shift)
+{
+  return average + ((sample - average) >> shift);
+}
+
+/**
+ * @brief Divides two integers, rounding to the nearest, halves away from zero.
+ *
+ * @param numerator The numerator.
+ * @param denominator The denominator, positive.
+ */
+constexpr int32_t divRound(int32_t numerator, int32_t denominator)
+{
+  return numerator >= 0 ? (numerator + denominator / 2) / denominator : (numerator - denominator / 2) / denominator;
+}
+
+static_assert(qRound(qMul(qFromInt(3, 8), qDiv(qFromInt(1, 8), qFromInt(4, 8), 8), 8), 8) == 1, "3 * 1/4 must round to 1");
+static_assert(qRound(-384, 8) == -1 && qRound(-385, 8) == -2, "Negative halves must round up");
+static_assert(divRound(7, 2) == 4 && divRound(-7, 2) == -4, "Halves must round away from zero");
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * File: Fragment.cpp
+ *
+ * Description:
+ * This source file implements the fragmentation layer: the message is
+ * kept in a buffer, and its fragments are queued one at a time by a task
+ * of the scheduler. The format is described in Fragment.hpp.
+ *
+ * Functions:
+ * - init_Fragment: Registers the fragmentation task in the scheduler.
+ * - queueLargeUplink: Queues a message, fragmented if it does not fit a frame.
+ * - fragmentBusy: Indicates whether a fragmented message is being sent.
+ * - fragmentParityLine: Selects the fragments of a parity fragment.
+ *
+ * Note:
+ * A single fragmented message is sent at a time, queueLargeUplink()
+ * rejects the next one until the last fragment has been queued.
+ */
+
+#include "Fragment.hpp"
+#include "Scheduler.hpp"
+
+// Message being fragmented, and the next fragment to queue (0 when idle).
+static uint8_t message[Config::FRAGMENT_MAX_LENGTH];
+static size_t messageLength;
+static uint8_t messageType;
+static UplinkPriority messagePriority;
+static uint8_t session = 0;
+static uint8_t fragmentCount;
+static uint8_t nextFragment = 0;
+
+/**
+ * @brief Returns the next state of the 23-bit PRBS of TS004.
+ */
+static uint32_t prbs23(uint32_t x)
+{
+  uint32_t b0 = x & 1;
+  uint32_t b1 = (x & 32) >> 5;
+  return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+/**
+ * @brief Task queuing the next fragment once the previous one has been sent.
+ */
+static void fragmentTask()
+{
+  if (nextFragment == 0 || uplinkQueued(UPLINK_FRAGMENT))
+  {
+    return;
+  }
+
+  uint8_t record[FRAGMENT_HEADER_SIZE + Config::FRAGMENT_SIZE];
+  record[0] = session;
+  record[1] = messageType;
+  record[2] = fragmentCount;
+  record[3] = nextFragment;
+  record[4] = messageLength >> 8;
+  record[5] = messageLength & 0xFF;
+
+  uint8_t *fragment = &record[FRAGMENT_HEADER_SIZE];
+  memset(fragment, 0, Config::FRAGMENT_SIZE);
+  if (nextFragment <= fragmentCount)
+  {
+    size_t offset = (size_t)(nextFragment - 1) * Config::FRAGMENT_SIZE;
+    memcpy(fragment, &message[offset], min(messageLength - offset, (size_t)Config::FRAGMENT_SIZE));
+  }
+  else
+  {
+    bool selected[FRAGMENT_MAX_COUNT];
+    fragmentParityLine(nextFragment - fragmentCount, fragmentCount, selected);
+    for (int i = 0; i < fragmentCount; i++)
+    {
+      size_t offset = (size_t)i * Config::FRAGMENT_SIZE;
+      for (size_t j = 0; selected[i] && j < Config::FRAGMENT_SIZE && offset + j < messageLength; j++)
+      {
+        fragment[j] ^= message[offset + j];
+      }
+    }
+  }
+
+  if (queueUplink(UPLINK_FRAGMENT, messagePriority, record, sizeof(record)))
+  {
+    nextFragment = nextFragment < fragmentCount + Config::FRAGMENT_REDUNDANCY ? nextFragment + 1 : 0;
+  }
+}
+
+/**
+ * @brief Registers the fragmentation task in the scheduler.
+ */
+void init_Fragment()
+{
+  addTask(fragmentTask, Config::UPLINK_CHECK_PERIOD_MS, Config::UPLINK_CHECK_PERIOD_MS);
+}
+
+/**
+ * @brief Queues a message, fragmented if it does not fit a frame.
+ *
+ * A message fitting a frame of Config::MIN_DATA_RATE is queued as is.
+ *
+ * @param type The record type of the message.
+ * @param priority The priority of the message, or of its fragments.
+ * @param data The value of the message.
+ * @param length The length of the value, at most Config::FRAGMENT_MAX_LENGTH.
+ *
+ * @return true if the message is queued, false if it is dropped or another one is being fragmented.
+ */
+bool queueLargeUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length)
+{
+  if (length <= Config::UPLINK_MESSAGE_MAX_LENGTH && UPLINK_RECORD_HEADER_SIZE + length <= eu868MaxPayload(Config::MIN_DATA_RATE))
+  {
+    return queueUplink(type, priority, data, length);
+  }
+  if (fragmentBusy() || length > Config::FRAGMENT_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  memcpy(message, data, length);
+  messageLength = length;
+  messageType = type;
+  messagePriority = priority;
+  session ++;
+  fragmentCount = (length + Config::FRAGMENT_SIZE - 1) / Config::FRAGMENT_SIZE;
+  nextFragment = 1;
+  return true;
+}
+
+/**
+ * @brief Indicates whether a fragmented message is being sent.
+ */
+bool fragmentBusy()
+{
+  return nextFragment != 0;
+}
+
+/**
+ * @brief Selects the fragments of a parity fragment.
+ *
+ * Computes the line of the parity matrix of TS004: half of the fragments,
+ * drawn with a 23-bit PRBS seeded by the line number.
+ *
+ * @param line The line of the parity matrix, from 1.
+ * @param count The number M of uncoded fragments.
+ * @param selected Set to true for each fragment of the parity fragment, count entries.
+ */
+void fragmentParityLine(uint8_t line, uint8_t count, bool selected[])
+{
+  // A power of two count draws from count + 1 values, as in TS004
+  uint8_t m = (count & (count - 1)) == 0 ? 1 : 0;
+  uint32_t x = 1 + 1001UL * line;
+
+  for (int i = 0; i < count; i++)
+  {
+    selected[i] = false;
+  }
+  for (int n = 0; n < count / 2; n++)
+  {
+    uint32_t r = count;
+    while (r >= count)
+    {
+      x = prbs23(x);
+      r = x % (count + m);
+    }
+    selected[r] = true;
+  }
+  // A single fragment is its own parity
+  if (count == 1)
+  {
+    selected[0] = true;
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * File: Fragment.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the fragmentation layer,
+ * sending the messages which do not fit a frame of Config::MIN_DATA_RATE
+ * (history pages, diagnostic blobs) across several uplinks.
+ *
+ * A message is split into M fragments of Config::FRAGMENT_SIZE bytes, the
+ * last one padded with zeros, followed by Config::FRAGMENT_REDUNDANCY
+ * parity fragments. As in the LoRaWAN fragmented data block transport
+ * (TS004), parity fragment M + n is the XOR of the fragments selected by
+ * the line n of a pseudo-random binary matrix (fragmentParityLine()), so
+ * the decoder recovers up to about FRAGMENT_REDUNDANCY lost fragments.
+ *
+ * Each fragment is queued as an UPLINK_FRAGMENT record, once the previous
+ * one has been sent:
+ * - byte 0: session, incremented for each message
+ * - byte 1: record type of the message
+ * - byte 2: number M of uncoded fragments
+ * - byte 3: fragment index, 1 to M for the uncoded fragments, then the parity fragments
+ * - bytes 4-5: length of the message (big-endian)
+ * - then FRAGMENT_SIZE bytes of fragment
+ *
+ * Functions:
+ * - init_Fragment: Registers the fragmentation task in the scheduler.
+ * - queueLargeUplink: Queues a message, fragmented if it does not fit a frame.
+ * - fragmentBusy: Indicates whether a fragmented message is being sent.
+ * - fragmentParityLine: Selects the fragments of a parity fragment.
+ */
+
+#ifndef HPP__FRAGMENT__HPP
+#define HPP__FRAGMENT__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+#include "Uplink.hpp"
+
+#define FRAGMENT_HEADER_SIZE 6
+#define FRAGMENT_MAX_COUNT ((Config::FRAGMENT_MAX_LENGTH + Config::FRAGMENT_SIZE - 1) / Config::FRAGMENT_SIZE)
+
+static_assert(FRAGMENT_HEADER_SIZE + Config::FRAGMENT_SIZE <= Config::UPLINK_MESSAGE_MAX_LENGTH, "A fragment exceeds UPLINK_MESSAGE_MAX_LENGTH");
+static_assert(UPLINK_RECORD_HEADER_SIZE + FRAGMENT_HEADER_SIZE + Config::FRAGMENT_SIZE <= eu868MaxPayload(Config::MIN_DATA_RATE),
+  "A fragment exceeds the maximum payload of MIN_DATA_RATE, decrease FRAGMENT_SIZE");
+static_assert(FRAGMENT_MAX_COUNT + Config::FRAGMENT_REDUNDANCY <= 255, "The fragment index must fit in one byte");
+
+void init_Fragment();
+bool queueLargeUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length);
+bool fragmentBusy();
+void fragmentParityLine(uint8_t line, uint8_t count, bool selected[]);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * File: Health.cpp
+ *
+ * Description:
+ * This source file implements the health frame, a periodic message
+ * reporting the link quality, the error counters, the modem, the channel,
+ * the sensor and the heater statistics of the node, and the configuration digest. The
+ * formats are described in Health.hpp.
+ *
+ * Functions:
+ * - init_Health: Registers the periodic health message in the scheduler.
+ * - encodeHealth: Encodes the health frame.
+ * - configDigest: Computes the configuration digest.
+ * - queueConfigDigest: Queues the configuration digest with the next data frame.
+ */
+
+#include "Health.hpp"
+#include "Scheduler.hpp"
+#include "Driver_LoRaWan.hpp"
+#include "Uplink.hpp"
+#include "LinkQuality.hpp"
+#include "Channels.hpp"
+#include "Heater.hpp"
+#include "Driver_SHT31.hpp"
+#include "Crc.hpp"
+
+/**
+ * @brief Appends a big-endian 32-bit value to a buffer.
+ */
+static uint8_t *putUint32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = value >> 24;
+  buffer[1] = (value >> 16) & 0xFF;
+  buffer[2] = (value >> 8) & 0xFF;
+  buffer[3] = value & 0xFF;
+  return buffer + 4;
+}
+
+/**
+ * @brief Task queuing the health frame, sent with the next data frame.
+ */
+static void healthTask()
+{
+  uint8_t frame[HEALTH_SIZE];
+  size_t size = encodeHealth(frame);
+  queueUplink(UPLINK_HEALTH, PRIORITY_HEALTH, frame, size);
+}
+
+/**
+ * @brief Registers the periodic health message in the scheduler.
+ */
+void init_Health()
+{
+  addTask(healthTask, Config::HEALTH_PERIOD_MS, Config::HEALTH_PERIOD_MS);
+}
+
+/**
+ * @brief Encodes the health frame.
+ *
+ * @param frame The buffer receiving the frame, HEALTH_SIZE bytes long.
+ *
+ * @return The size of the frame.
+ */
+size_t encodeHealth(uint8_t frame[])
+{
+  uint16_t errors = err_count > 0xFFFF ? 0xFFFF : err_count;
+  uint16_t wakeLatency = modemWakeLatencyMax > 0xFFFF ? 0xFFFF : modemWakeLatencyMax;
+  uint32_t uptime = millis() / 1000;
+  uint32_t energy = heaterEnergy() / 1000;
+  uint16_t heaterJoules = energy > 0xFFFF ? 0xFFFF : energy;
+
+  frame[0] = HEALTH_VERSION;
+  frame[1] = linkSuccessRate();
+  frame[2] = linkMargin();
+  frame[3] = linkQuality.gatewayCount;
+  frame[4] = errors >> 8;
+  frame[5] = errors & 0xFF;
+  frame[6] = modemResetCount > 255 ? 255 : modemResetCount;
+  frame[7] = wakeLatency >> 8;
+  frame[8] = wakeLatency & 0xFF;
+  frame[9] = uptime >> 24;
+  frame[10] = (uptime >> 16) & 0xFF;
+  frame[11] = (uptime >> 8) & 0xFF;
+  frame[12] = uptime & 0xFF;
+  frame[13] = preferredChannelMask() >> 8;
+  frame[14] = preferredChannelMask() & 0xFF;
+  for (int i = 0; i < 8; i++)
+  {
+    frame[15 + i] = i < Config::CHANNEL_COUNT ? channelSuccessRate(i) : 0;
+  }
+  frame[23] = heaterPulseCount >> 8;
+  frame[24] = heaterPulseCount & 0xFF;
+  frame[25] = heaterJoules >> 8;
+  frame[26] = heaterJoules & 0xFF;
+  frame[27] = sht31FailureCount >> 8;
+  frame[28] = sht31FailureCount & 0xFF;
+  frame[29] = i2cBusClearCount;
+  frame[30] = sht31ResetCount;
+  return HEALTH_SIZE;
+}
+
+/**
+ * @brief Computes the configuration digest.
+ *
+ * @return The CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) of the settings and of the current state.
+ */
+uint16_t configDigest()
+{
+  uint8_t settings[38];
+  uint8_t *p = settings;
+
+  // Configuration
+  p = putUint32(p, Config::REPORT_INTERVAL_MS);
+  *p++ = Config::BATCH_SIZE;
+  p = putUint32(p, Config::HEALTH_PERIOD_MS);
+  *p++ = Config::DATA_RATE;
+  *p++ = Config::MIN_DATA_RATE;
+  *p++ = Config::DEVICE_CLASS;
+  p = putUint32(p, Config::CLASS_C_WINDOW_PERIOD_MS);
+  p = putUint32(p, Config::CLASS_C_WINDOW_DURATION_MS);
+  p = putUint32(p, Config::DOWNLINK_POLL_PERIOD_MS);
+  p = putUint32(p, Config::MIN_POLL_INTERVAL_S);
+  *p++ = Config::UPLINK_PORT;
+
+  // Current state
+  *p++ = dataRate;
+  p = putUint32(p, commandWindowMs);
+  *p++ = enabledChannelMask() >> 8;
+  *p++ = enabledChannelMask() & 0xFF;
+  *p++ = preferredChannelMask() >> 8;
+  *p++ = preferredChannelMask() & 0xFF;
+
+  return crc16Ccitt(settings, p - settings);
+}
+
+/**
+ * @brief Queues the configuration digest with the next data frame.
+ */
+void queueConfigDigest()
+{
+  uint16_t digest = configDigest();
+  uint8_t record[2] = { (uint8_t)(digest >> 8), (uint8_t)(digest & 0xFF) };
+  replaceUplink(UPLINK_CONFIG, PRIORITY_ACK, record, sizeof(record));
+}
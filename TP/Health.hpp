@@ -0,0 +1,69 @@
+/*
+ * File: Health.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the health frame, a
+ * periodic message reporting the state of the node: link quality, error
+ * counters, modem, channel, sensor and heater statistics. It is queued as an
+ * UPLINK_HEALTH record of low priority, and usually shares a frame with
+ * the data.
+ *
+ * Record format (big-endian):
+ * - byte 0: frame version (HEALTH_VERSION)
+ * - byte 1: average uplink success rate, in percent
+ * - byte 2: average demodulation margin, in dB
+ * - byte 3: number of gateways of the last LinkCheckAns
+ * - bytes 4-5: consecutive transmission errors
+ * - byte 6: modem resets (saturated at 255)
+ * - bytes 7-8: maximum modem wake latency, in milliseconds
+ * - bytes 9-12: uptime, in seconds
+ * - bytes 13-14: preferred channel mask
+ * - bytes 15-22: average success rate of the probes of channels 0 to 7, in percent
+ * - bytes 23-24: SHT31 heater pulses (saturated at 65535)
+ * - bytes 25-26: energy spent in the SHT31 heater, in joules (saturated at 65535)
+ * - bytes 27-28: failed SHT31 measurements (saturated at 65535)
+ * - byte 29: I2C bus clears, SDA found stuck low (saturated at 255)
+ * - byte 30: SHT31 resets (saturated at 255)
+ *
+ * The configuration digest is a CRC-16/CCITT of the settings a network
+ * server may want to check after a reconfiguration (reporting intervals,
+ * data rates, downlink mode, windows, polling and port), followed by the
+ * state the node runs with: current data rate, duration of the last window
+ * opened by a downlink command, channels enabled by the network and
+ * preferred channel mask, in the order encoded by configDigest(). Before
+ * the join, this state is the configured one, so the digest answered to
+ * the provisioning host only depends on the firmware.
+ * It is queued as an UPLINK_CONFIG record of two bytes (big-endian) after
+ * the join, after each accepted downlink command and after each change of
+ * the data rate or of the preferred channel mask, replacing any digest
+ * still waiting in the queue.
+ *
+ * Functions:
+ * - init_Health: Registers the periodic health message in the scheduler.
+ * - encodeHealth: Encodes the health frame.
+ * - configDigest: Computes the configuration digest.
+ * - queueConfigDigest: Queues the configuration digest with the next data frame.
+ */
+
+#ifndef HPP__HEALTH__HPP
+#define HPP__HEALTH__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+#define HEALTH_VERSION 4
+#define HEALTH_SIZE 31
+
+static_assert(HEALTH_SIZE <= Config::UPLINK_MESSAGE_MAX_LENGTH, "The health frame exceeds UPLINK_MESSAGE_MAX_LENGTH");
+static_assert(UPLINK_RECORD_HEADER_SIZE + HEALTH_SIZE <= eu868MaxPayload(Config::MIN_DATA_RATE), "The health frame exceeds the maximum payload of MIN_DATA_RATE");
+// Worst case: the health record never shares a frame with the data
+static_assert(eu868DutyCyclePpm(configPayloadSize(), Config::MIN_DATA_RATE, Config::TX_TRANSMISSIONS, configUplinkIntervalMs())
+  + eu868DutyCyclePpm(UPLINK_RECORD_HEADER_SIZE + HEALTH_SIZE, Config::MIN_DATA_RATE, Config::TX_TRANSMISSIONS, Config::HEALTH_PERIOD_MS) <= EU868_MAX_DUTY_CYCLE_PPM,
+  "The data and health uplinks together exceed the EU868 1 % duty cycle, increase HEALTH_PERIOD_MS");
+
+void init_Health();
+size_t encodeHealth(uint8_t frame[]);
+uint16_t configDigest();
+void queueConfigDigest();
+
+#endif
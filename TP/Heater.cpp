@@ -0,0 +1,133 @@
+/*
+ * File: Heater.cpp
+ *
+ * Description:
+ * This source file implements the heater policy of the SHT31: a pulse is
+ * started from the application task when a sample reaches the threshold,
+ * and a one-shot task of the scheduler switches the heater off at its end.
+ * The policy is described in Heater.hpp.
+ *
+ * Functions:
+ * - heaterAffects: Indicates whether the next sample is affected by the heater.
+ * - updateHeater: Starts a pulse if a sample shows a saturated sensor.
+ * - heaterEnergy: Returns the energy spent in the heater since the reset.
+ * - heaterReset: Records that a reset of the sensor switched the heater off.
+ */
+
+#include "Heater.hpp"
+#include "Driver_SHT31.hpp"
+#include "Scheduler.hpp"
+
+uint16_t heaterPulseCount = 0;
+
+static bool heaterOn = false;
+static unsigned long pulseStart = 0;
+static unsigned long pulseEnd = 0;
+static unsigned long heaterOnMs = 0;
+
+// Task switching the heater off, SCHEDULER_NO_TASK if none is pending.
+static int offTask = SCHEDULER_NO_TASK;
+
+/**
+ * @brief Ends the current pulse and adds its duration to the heater time.
+ */
+static void endPulse()
+{
+  heaterOn = false;
+  pulseEnd = millis();
+  heaterOnMs += pulseEnd - pulseStart;
+}
+
+/**
+ * @brief Task switching the heater off at the end of a pulse.
+ *
+ * If the sensor does not acknowledge the command, it is sent again
+ * HEATER_RETRY_MS later, the samples stay flagged meanwhile.
+ */
+static void heaterOffTask()
+{
+  offTask = SCHEDULER_NO_TASK;
+  if (!sht31Command(SHT31_HEATER_OFF_COMMAND))
+  {
+    offTask = addTask(heaterOffTask, HEATER_RETRY_MS, 0);
+    return;
+  }
+  endPulse();
+}
+
+/**
+ * @brief Indicates whether the next sample is affected by the heater.
+ *
+ * @return true while the heater is on and during HEATER_SETTLE_MS after a pulse.
+ */
+bool heaterAffects()
+{
+  return heaterOn || (heaterPulseCount > 0 && millis() - pulseEnd < Config::HEATER_SETTLE_MS);
+}
+
+/**
+ * @brief Starts a pulse if a sample shows a saturated sensor.
+ *
+ * Nothing is done for an invalid or heated sample, or before
+ * HEATER_PERIOD_MS since the start of the previous pulse.
+ *
+ * @param humidity The humidity of the last sample, in 0.01 %.
+ */
+void updateHeater(int16_t humidity)
+{
+  if (!Config::HEATER_ENABLED || humidity == INVALID_HUNDREDTHS || humidity < Config::HEATER_RH_THRESHOLD || heaterAffects())
+  {
+    return;
+  }
+  if (heaterPulseCount > 0 && millis() - pulseStart < Config::HEATER_PERIOD_MS)
+  {
+    return;
+  }
+
+  if (!sht31Command(SHT31_HEATER_ON_COMMAND))
+  {
+    return;
+  }
+  heaterOn = true;
+  pulseStart = millis();
+  if (heaterPulseCount < 0xFFFF)
+  {
+    heaterPulseCount ++;
+  }
+  offTask = addTask(heaterOffTask, Config::HEATER_PULSE_MS, 0);
+  if (offTask == SCHEDULER_NO_TASK)
+  {
+    heaterOffTask(); // Never leave the heater on without a task to switch it off
+  }
+}
+
+/**
+ * @brief Returns the energy spent in the heater since the reset.
+ *
+ * @return The energy in millijoules, estimated with HEATER_POWER_MW.
+ */
+uint32_t heaterEnergy()
+{
+  unsigned long onMs = heaterOnMs + (heaterOn ? millis() - pulseStart : 0);
+  return (uint32_t)((uint64_t)onMs * Config::HEATER_POWER_MW / 1000);
+}
+
+/**
+ * @brief Records that a reset of the sensor switched the heater off.
+ *
+ * Called by recoverSHT31(): the pulse in progress ends at the reset, its
+ * pending heater off command is cancelled, and the samples stay flagged
+ * for HEATER_SETTLE_MS as after a normal pulse.
+ */
+void heaterReset()
+{
+  if (offTask != SCHEDULER_NO_TASK)
+  {
+    stopTask(offTask);
+    offTask = SCHEDULER_NO_TASK;
+  }
+  if (heaterOn)
+  {
+    endPulse();
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ * File: Heater.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the heater policy of the
+ * SHT31. A sensor left in condensing air saturates and keeps reading
+ * 100 % long after the air has dried, its samples then cost airtime
+ * without carrying information. When a sample reaches
+ * Config::HEATER_RH_THRESHOLD, the internal heater is switched on for
+ * Config::HEATER_PULSE_MS to evaporate the water on the sensor, at most
+ * once every Config::HEATER_PERIOD_MS.
+ *
+ * The heater warms the sensor up by a few degrees, so the samples taken
+ * during a pulse and Config::HEATER_SETTLE_MS after are flagged as heated:
+ * they are still transmitted, but neither recorded in the history nor
+ * used by the derived metrics.
+ *
+ * The number of pulses and the energy spent in the heater, estimated
+ * with Config::HEATER_POWER_MW, are reported in the health frame.
+ *
+ * Functions:
+ * - heaterAffects: Indicates whether the next sample is affected by the heater.
+ * - updateHeater: Starts a pulse if a sample shows a saturated sensor.
+ * - heaterEnergy: Returns the energy spent in the heater since the reset.
+ * - heaterReset: Records that a reset of the sensor switched the heater off.
+ */
+
+#ifndef HPP__HEATER__HPP
+#define HPP__HEATER__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+// Delay before a new attempt to switch the heater off when the sensor does not answer
+#define HEATER_RETRY_MS 1000
+
+extern uint16_t heaterPulseCount;
+
+bool heaterAffects();
+void updateHeater(int16_t humidity);
+uint32_t heaterEnergy();
+void heaterReset();
+
+#endif
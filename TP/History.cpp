@@ -0,0 +1,322 @@
+/*
+ * File: History.cpp
+ *
+ * Description:
+ * This source file implements the sample history. The samples are
+ * delta-encoded into a page buffer in RAM, written to the flash once
+ * full, in a circular area of Config::HISTORY_ROWS rows: a row is erased
+ * before its first page is written, dropping the oldest samples. The
+ * format of the pages is described in History.hpp.
+ *
+ * Functions:
+ * - init_History: Finds the end of the history and registers the backfill.
+ * - recordSample: Appends a sample to the history.
+ * - isHistoryFlash: Checks whether a flash range overlaps the history.
+ *
+ * Note:
+ * The flash area is a constant array, so that the linker reserves it in
+ * the flash after the program; it is written with the NVM controller.
+ * The samples of the page buffer are lost on reset, they have been sent
+ * with the live data anyway. Their sequence numbers are kept in RAM across
+ * warm resets, and skipped after a power loss, so that they are not reused.
+ */
+
+#include "History.hpp"
+#include "Scheduler.hpp"
+#include "Downlink.hpp"
+#include "Uplink.hpp"
+#include "Fragment.hpp"
+#include "Metrics.hpp"
+
+// Flash area of the history, aligned on a row so that it can be erased. It is
+// only read through volatile pointers: GCC places const volatile objects in
+// RAM, and the compiler must not assume the content stays zero. A factory
+// image aligns it on a lock region, so that the region of the credentials
+// record (see Driver_Credentials.cpp) can be locked.
+__attribute__((aligned(Config::FACTORY_CREDENTIALS ? FLASH_LOCK_REGION_SIZE : HISTORY_ROW_SIZE)))
+static const uint8_t historyFlash[Config::HISTORY_ROWS * HISTORY_ROW_SIZE] = {};
+
+// Page being filled, index of the flash page it is written to, sequence
+// number of the next sample and last value of the page.
+static uint8_t page[FLASH_PAGE_SIZE];
+static uint16_t pageIndex = 0;
+static uint32_t nextSequence = 0;
+static int16_t lastTemperature;
+static int16_t lastHumidity;
+
+// Next sequence number and its complement, kept across warm resets (see tools/noinit.ld).
+static uint32_t savedSequence[2] __attribute__((section(".noinit")));
+
+// Backfill request: range of sequence numbers, and next flash page to scan.
+static bool backfillActive = false;
+static uint32_t backfillFirst;
+static uint32_t backfillLast;
+static uint16_t backfillPage;
+static uint16_t backfillRemaining;
+
+/**
+ * @brief Returns the address of a flash page of the history.
+ */
+static const volatile uint8_t *flashPage(uint16_t index)
+{
+  return (const volatile uint8_t *)&historyFlash[(uint32_t)index * FLASH_PAGE_SIZE];
+}
+
+/**
+ * @brief Reads a big-endian 32-bit value.
+ */
+static uint32_t readUint32(const volatile uint8_t bytes[])
+{
+  return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+/**
+ * @brief Indicates whether a flash page holds samples.
+ *
+ * Erased pages read 0xFF and the pages of a fresh upload read 0.
+ */
+static bool pageValid(const volatile uint8_t data[])
+{
+  return data[4] != 0 && data[4] != 0xFF && data[5] >= HISTORY_HEADER_SIZE && data[5] <= FLASH_PAGE_SIZE;
+}
+
+/**
+ * @brief Waits for the NVM controller to complete its command.
+ */
+static void flashWaitReady()
+{
+  while (NVMCTRL->INTFLAG.bit.READY == 0)
+  {
+  }
+}
+
+/**
+ * @brief Writes the page buffer into its flash page, erasing the row first if needed.
+ */
+static void flashWritePage()
+{
+  volatile uint8_t *destination = (volatile uint8_t *)flashPage(pageIndex);
+
+  NVMCTRL->CTRLB.bit.MANW = 1;
+  NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK;
+  if (pageIndex % 4 == 0)
+  {
+    // The ADDR register holds the address in 16-bit words
+    NVMCTRL->ADDR.reg = (uintptr_t)destination / 2;
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+    flashWaitReady();
+  }
+
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+  flashWaitReady();
+  // The page buffer is written with 32-bit accesses
+  for (int i = 0; i < FLASH_PAGE_SIZE; i += 4)
+  {
+    uint32_t word;
+    memcpy(&word, &page[i], sizeof(word));
+    *(volatile uint32_t *)&destination[i] = word;
+  }
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+  flashWaitReady();
+
+  pageIndex = (pageIndex + 1) % HISTORY_PAGES;
+}
+
+/**
+ * @brief Starts a new page buffer with a first sample.
+ */
+static void startPage(int16_t temperature, int16_t humidity)
+{
+  memset(page, 0xFF, sizeof(page));
+  page[0] = nextSequence >> 24;
+  page[1] = (nextSequence >> 16) & 0xFF;
+  page[2] = (nextSequence >> 8) & 0xFF;
+  page[3] = nextSequence & 0xFF;
+  page[4] = 1;
+  page[5] = HISTORY_HEADER_SIZE;
+  page[6] = (uint16_t)temperature >> 8;
+  page[7] = (uint16_t)temperature & 0xFF;
+  page[8] = (uint16_t)humidity >> 8;
+  page[9] = (uint16_t)humidity & 0xFF;
+}
+
+/**
+ * @brief Encodes the difference between two values as a zigzag varint.
+ *
+ * @param value The new value.
+ * @param previous The previous value.
+ * @param buffer The buffer receiving the varint, at least 3 bytes long.
+ *
+ * @return The size of the varint.
+ */
+static size_t encodeDelta(int16_t value, int16_t previous, uint8_t buffer[])
+{
+  // Differences wrap around on 16 bits, as the decoder adds them on 16 bits
+  int16_t delta = (int16_t)(uint16_t)((uint16_t)value - (uint16_t)previous);
+  uint16_t zigzag = (uint16_t)((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+  size_t size = 0;
+  while (zigzag >= 0x80)
+  {
+    buffer[size++] = (zigzag & 0x7F) | 0x80;
+    zigzag >>= 7;
+  }
+  buffer[size++] = zigzag;
+  return size;
+}
+
+/**
+ * @brief Downlink command requesting the samples of a range of sequence numbers.
+ *
+ * @param data The first and the last sequence numbers, as big-endian 32-bit values.
+ * @param length The length of the data, 8 bytes.
+ *
+ * @return true if the range is valid.
+ */
+static bool backfillCommand(const uint8_t data[], size_t length)
+{
+  if (length != 8)
+  {
+    return false;
+  }
+  uint32_t first = (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+  uint32_t last = (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 8 | data[7];
+  if (first > last)
+  {
+    return false;
+  }
+
+  // Scan the whole area once, from the oldest page
+  backfillFirst = first;
+  backfillLast = last;
+  backfillPage = pageIndex;
+  backfillRemaining = HISTORY_PAGES;
+  backfillActive = true;
+  return true;
+}
+
+/**
+ * @brief Task queuing the next history page of the backfill range.
+ *
+ * A page is queued only once the previous one has been sent, so that the
+ * backfill never fills the uplink queue.
+ */
+static void backfillTask()
+{
+  if (!backfillActive || uplinkQueued(UPLINK_HISTORY) || fragmentBusy())
+  {
+    return;
+  }
+
+  while (backfillRemaining > 0)
+  {
+    const volatile uint8_t *data = flashPage(backfillPage);
+    backfillPage = (backfillPage + 1) % HISTORY_PAGES;
+    backfillRemaining --;
+
+    uint32_t first = readUint32(data);
+    if (pageValid(data) && first <= backfillLast && first + data[4] - 1 >= backfillFirst)
+    {
+      uint8_t record[FLASH_PAGE_SIZE];
+      for (int i = 0; i < data[5]; i++)
+      {
+        record[i] = data[i];
+      }
+      queueLargeUplink(UPLINK_HISTORY, PRIORITY_BULK, record, data[5]);
+      return;
+    }
+  }
+  backfillActive = false;
+  console.println("Backfill completed");
+}
+
+/**
+ * @brief Finds the end of the history and registers the backfill.
+ *
+ * The page holding the highest sequence number is the last page written:
+ * the history continues on the next page. The next sequence number is the
+ * one saved before a warm reset if it is valid. Otherwise, the samples of
+ * the page buffer lost with the power may have used the numbers following
+ * the last page, which are skipped.
+ */
+void init_History()
+{
+  bool found = false;
+  for (uint16_t i = 0; i < HISTORY_PAGES; i++)
+  {
+    const volatile uint8_t *data = flashPage(i);
+    uint32_t first = readUint32(data);
+    if (pageValid(data) && (!found || first >= nextSequence))
+    {
+      found = true;
+      nextSequence = first + data[4];
+      pageIndex = (i + 1) % HISTORY_PAGES;
+    }
+  }
+  if (savedSequence[1] == ~savedSequence[0] && savedSequence[0] >= nextSequence)
+  {
+    nextSequence = savedSequence[0];
+  }
+  else if (found)
+  {
+    nextSequence += HISTORY_PAGE_MAX_SAMPLES;
+  }
+  page[4] = 0;
+
+  registerDownlinkHandler(DOWNLINK_CMD_BACKFILL, backfillCommand);
+  addTask(backfillTask, Config::BACKFILL_PERIOD_MS, Config::BACKFILL_PERIOD_MS);
+}
+
+/**
+ * @brief Appends a sample to the history.
+ *
+ * The page buffer is written to the flash when the sample does not fit
+ * anymore, and the sample starts a new page.
+ *
+ * @param t The temperature, in 0.01 degree C.
+ * @param h The relative humidity, in 0.01 %.
+ *
+ * @return The sequence number of the sample.
+ */
+uint32_t recordSample(int16_t t, int16_t h)
+{
+  if (page[4] == 0)
+  {
+    startPage(t, h);
+  }
+  else
+  {
+    uint8_t deltas[6];
+    size_t size = encodeDelta(t, lastTemperature, deltas);
+    size += encodeDelta(h, lastHumidity, &deltas[size]);
+    if (page[5] + size > FLASH_PAGE_SIZE || page[4] == HISTORY_PAGE_MAX_SAMPLES)
+    {
+      flashWritePage();
+      startPage(t, h);
+    }
+    else
+    {
+      memcpy(&page[page[5]], deltas, size);
+      page[4] ++;
+      page[5] += size;
+    }
+  }
+
+  lastTemperature = t;
+  lastHumidity = h;
+  savedSequence[0] = nextSequence + 1;
+  savedSequence[1] = ~savedSequence[0];
+  return nextSequence++;
+}
+
+/**
+ * @brief Checks whether a flash range overlaps the flash area of the history.
+ *
+ * @param start First address of the range.
+ * @param end Address following the range.
+ * @return true if the range holds a part of the history.
+ */
+bool isHistoryFlash(uintptr_t start, uintptr_t end)
+{
+  uintptr_t history = (uintptr_t)historyFlash;
+  return start < history + sizeof(historyFlash) && history < end;
+}
@@ -0,0 +1,62 @@
+/*
+ * File: History.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the sample history, kept
+ * compressed in the internal flash so that the gaps of the backend series
+ * can be filled again after a backend or gateway outage.
+ *
+ * Each sample is numbered by a sequence number, which persists across
+ * resets and is sent at the start of each data record: it is the time
+ * base of the history. A number is never given twice: the samples of the
+ * page buffer are lost on reset, so after a power loss the history skips
+ * the HISTORY_PAGE_MAX_SAMPLES numbers they may have used.
+ *
+ * A downlink DOWNLINK_CMD_BACKFILL [t0 (4 bytes)] [t1 (4 bytes)]
+ * (big-endian sequence numbers) requests the samples t0 to t1: the flash
+ * pages holding them are queued one at a time as
+ * UPLINK_HISTORY records of PRIORITY_BULK, so they fill the room left in
+ * the data frames and only use the duty cycle budget above the reserve.
+ * At the slow data rates, the pages are fragmented (see Fragment.hpp).
+ *
+ * History page format (big-endian), also the value of an UPLINK_HISTORY record:
+ * - bytes 0-3: sequence number of the first sample
+ * - byte 4: number of samples
+ * - byte 5: number of used bytes of the page
+ * - bytes 6-7: temperature of the first sample, in 0.01 degree C
+ * - bytes 8-9: humidity of the first sample, in 0.01 %
+ * - then, for each next sample, the differences with the previous sample
+ *   of the temperature and of the humidity, as zigzag varints
+ * A value of INVALID_HUNDREDTHS (see FixedPoint.hpp) marks a failed reading.
+ *
+ * Functions:
+ * - init_History: Finds the end of the history and registers the backfill.
+ * - recordSample: Appends a sample to the history.
+ * - isHistoryFlash: Checks whether a flash range overlaps the history.
+ */
+
+#ifndef HPP__HISTORY__HPP
+#define HPP__HISTORY__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+// SAMD21 flash rows are erased 4 pages at a time
+#define HISTORY_ROW_SIZE (4 * FLASH_PAGE_SIZE)
+#define HISTORY_PAGES (Config::HISTORY_ROWS * 4)
+#define HISTORY_HEADER_SIZE 10
+
+// The NVM controller locks the flash in 16 regions of equal size
+#define FLASH_LOCK_REGIONS 16
+#define FLASH_LOCK_REGION_SIZE (FLASH_SIZE / FLASH_LOCK_REGIONS)
+
+// Samples of a full page: the first one, then 2 bytes for each next one at best
+#define HISTORY_PAGE_MAX_SAMPLES min(1 + (FLASH_PAGE_SIZE - HISTORY_HEADER_SIZE) / 2, 0xFE)
+
+static_assert(FLASH_PAGE_SIZE <= Config::FRAGMENT_MAX_LENGTH, "A history page exceeds FRAGMENT_MAX_LENGTH");
+
+void init_History();
+uint32_t recordSample(int16_t temperature, int16_t humidity);
+bool isHistoryFlash(uintptr_t start, uintptr_t end);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * File: LinkQuality.cpp
+ *
+ * Description:
+ * This source file implements the link quality estimator. The outcome of
+ * every uplink and the answers to the periodic LinkCheckReq are averaged
+ * with integer exponentially weighted moving averages:
+ *   average += (value * 256 - average) / 2^LINK_EWMA_SHIFT
+ *
+ * Functions:
+ * - recordTxResult: Records the outcome of an uplink.
+ * - linkCheckDue: Indicates whether the next uplink should carry a LinkCheckReq.
+ * - requestLinkCheck: Asks the modem to add a LinkCheckReq to the next uplink.
+ * - readLinkCheck: Reads the LinkCheckAns received after an uplink.
+ * - linkSuccessRate: Returns the average uplink success rate.
+ * - linkMargin: Returns the average demodulation margin.
+ * - linkLost: Indicates whether the link is considered lost.
+ * - linkDataRate: Returns the data rate suited to the measured link.
+ * - resetLinkQuality: Restarts the averages after a join.
+ */
+
+#include "LinkQuality.hpp"
+#include "Driver_Credentials.hpp"
+#include "FixedPoint.hpp"
+
+// Link quality measurements, the success rate starts at 100 %.
+LinkQuality linkQuality = { 100 << 8, 0, 0, 0, 0, 0, 0 };
+
+/**
+ * @brief Updates an exponentially weighted moving average.
+ *
+ * @param average The average, in 1/256 units.
+ * @param value The new value, in units.
+ *
+ * @return The updated average.
+ */
+static int32_t ewma(int32_t average, int32_t value)
+{
+  return qEwma(average, qFromInt(value, 8), LINK_EWMA_SHIFT);
+}
+
+/**
+ * @brief Records the outcome of an uplink.
+ *
+ * @param success true if the uplink was acknowledged.
+ */
+void recordTxResult(bool success)
+{
+  linkQuality.uplinks ++;
+  linkQuality.successRate = ewma(linkQuality.successRate, success ? 100 : 0);
+}
+
+/**
+ * @brief Indicates whether the next uplink should carry a LinkCheckReq.
+ *
+ * @return true every Config::LINK_CHECK_PERIOD uplinks, starting with the first one.
+ */
+bool linkCheckDue()
+{
+  return Config::LINK_CHECK_PERIOD > 0 && linkQuality.uplinks % Config::LINK_CHECK_PERIOD == 0;
+}
+
+/**
+ * @brief Asks the modem to add a LinkCheckReq to the next uplink.
+ */
+void requestLinkCheck()
+{
+  SerialLoRa.println(LINKCHECK_REQUEST_COMMAND);
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS);
+  linkQuality.linkChecks ++;
+}
+
+/**
+ * @brief Reads the LinkCheckAns received after an uplink.
+ *
+ * The answer holds the demodulation margin of the best gateway in dB and
+ * the number of gateways which received the uplink. A missing answer
+ * counts as a margin of 0 dB.
+ *
+ * @return true if an answer was received.
+ */
+bool readLinkCheck()
+{
+  SerialLoRa.println(LINKCHECK_ANSWER_COMMAND);
+  char response[MODEM_RESPONSE_MAX_LENGTH + 1];
+  const char *value = NULL;
+  if (readModemResponse(response, sizeof(response), Config::MODEM_RESPONSE_TIMEOUT_MS) > 0 && strstr(response, "+ERR") == NULL)
+  {
+    value = strchr(response, '=');
+  }
+
+  if (value == NULL || strchr(value, ',') == NULL)
+  {
+    linkQuality.linkChecksMissed ++;
+    linkQuality.margin = ewma(linkQuality.margin, 0);
+    return false;
+  }
+
+  linkQuality.lastMargin = (uint8_t)strtoul(value + 1, NULL, 10);
+  linkQuality.gatewayCount = (uint8_t)strtoul(strchr(value, ',') + 1, NULL, 10);
+  linkQuality.margin = ewma(linkQuality.margin, linkQuality.lastMargin);
+  return true;
+}
+
+/**
+ * @brief Returns the average uplink success rate, in percent.
+ */
+uint8_t linkSuccessRate()
+{
+  return qRound(linkQuality.successRate, 8);
+}
+
+/**
+ * @brief Returns the average demodulation margin, in dB.
+ */
+uint8_t linkMargin()
+{
+  return linkQuality.margin > 0 ? qRound(linkQuality.margin, 8) : 0;
+}
+
+/**
+ * @brief Indicates whether the link is considered lost.
+ *
+ * @return true if the average success rate fell below Config::LINK_LOST_PERCENT.
+ */
+bool linkLost()
+{
+  return linkSuccessRate() < Config::LINK_LOST_PERCENT;
+}
+
+/**
+ * @brief Returns the data rate suited to the measured link.
+ *
+ * The data rate is lowered by one step when the success rate falls below
+ * Config::LINK_SLOWDOWN_PERCENT, and raised by one step when the margin
+ * exceeds Config::LINK_SPEEDUP_MARGIN_DB. It stays between 
+ * Config::MIN_DATA_RATE and Config::DATA_RATE, for which the payload size
+ * and the duty cycle are checked at compile time.
+ *
+ * @param dataRate The current data rate.
+ *
+ * @return The data rate to use for the next uplinks.
+ */
+uint8_t linkDataRate(uint8_t dataRate)
+{
+  if (linkSuccessRate() < Config::LINK_SLOWDOWN_PERCENT && dataRate > Config::MIN_DATA_RATE)
+  {
+    return dataRate - 1;
+  }
+  if (linkMargin() >= Config::LINK_SPEEDUP_MARGIN_DB && linkSuccessRate() >= Config::LINK_SLOWDOWN_PERCENT && dataRate < Config::DATA_RATE)
+  {
+    return dataRate + 1;
+  }
+  return dataRate;
+}
+
+
+/**
+ * @brief Restarts the averages after a join.
+ *
+ * The success rate restarts at 100 % so that the failures which led to the
+ * rejoin do not declare the new session lost. The counters are kept.
+ */
+void resetLinkQuality()
+{
+  linkQuality.successRate = 100 << 8;
+  linkQuality.margin = 0;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*
+ * File: LinkQuality.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the link quality estimator.
+ * It records the outcome of every uplink and, periodically, the answer of
+ * a LinkCheckReq MAC command (demodulation margin of the best gateway and
+ * number of gateways), and maintains exponentially weighted moving averages
+ * of the uplink success rate and of the margin.
+ *
+ * The averages drive the retry policy (link lost), the local data rate
+ * policy and are reported in the health frame.
+ *
+ * Functions:
+ * - recordTxResult: Records the outcome of an uplink.
+ * - linkCheckDue: Indicates whether the next uplink should carry a LinkCheckReq.
+ * - requestLinkCheck: Asks the modem to add a LinkCheckReq to the next uplink.
+ * - readLinkCheck: Reads the LinkCheckAns received after an uplink.
+ * - linkSuccessRate: Returns the average uplink success rate.
+ * - linkMargin: Returns the average demodulation margin.
+ * - linkLost: Indicates whether the link is considered lost.
+ * - linkDataRate: Returns the data rate suited to the measured link.
+ * - resetLinkQuality: Restarts the averages after a join.
+ */
+
+#ifndef HPP__LINKQUALITY__HPP
+#define HPP__LINKQUALITY__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+// AT commands of the modem firmware requesting a LinkCheckReq on the next
+// uplink and reading the last LinkCheckAns ("+OK=<margin>,<gateways>").
+#define LINKCHECK_REQUEST_COMMAND "AT$LINKCHECK"
+#define LINKCHECK_ANSWER_COMMAND "AT$LINKCHECK?"
+
+// Weight of a new value in the moving averages: 1 / 2^LINK_EWMA_SHIFT.
+#define LINK_EWMA_SHIFT 3
+
+// Link quality measurements, averages are in 1/256 units.
+struct LinkQuality
+{
+  uint16_t successRate;
+  int16_t margin;
+  uint8_t lastMargin;
+  uint8_t gatewayCount;
+  uint32_t uplinks;
+  uint32_t linkChecks;
+  uint32_t linkChecksMissed;
+};
+
+extern LinkQuality linkQuality;
+
+void recordTxResult(bool success);
+bool linkCheckDue();
+void requestLinkCheck();
+bool readLinkCheck();
+uint8_t linkSuccessRate();
+uint8_t linkMargin();
+bool linkLost();
+uint8_t linkDataRate(uint8_t dataRate);
+void resetLinkQuality();
+
+#endif
@@ -0,0 +1,359 @@
+/*
+ * File: Metrics.cpp
+ *
+ * Description:
+ * This source file implements the derived metrics of a sample in fixed
+ * point, with integer arithmetic only:
+ * - dew point: Magnus formula (b = 17.62, c = 243.12 degrees C), the
+ *   humidity normalised to 50 - 100 % by powers of two, and its logarithm
+ *   read from a table of 0.5 % steps;
+ * - absolute humidity: saturation vapour pressure read from a table of
+ *   1 degree C steps (Magnus formula), from -40 to 85 degrees C;
+ * - heat index: regression of Rothfusz, or the simple formula of the US
+ *   National Weather Service below 80 degrees F, without the adjustments
+ *   for extreme humidities.
+ * Both tables are linearly interpolated.
+ *
+ * Functions:
+ * - init_Metrics: Runs the benchmark if enabled.
+ * - toHundredths: Converts a reading to hundredths.
+ * - dewPoint: Computes the dew point.
+ * - absoluteHumidity: Computes the absolute humidity.
+ * - heatIndex: Computes the heat index.
+ * - updateMetrics: Computes the metrics of a sample and updates the alarm.
+ *
+ * Note:
+ * The float references are only used by the benchmark, and are dropped
+ * by the linker when Config::METRICS_BENCHMARK is disabled.
+ */
+
+#include <math.h>
+#include "Metrics.hpp"
+#include "Uplink.hpp"
+#include "Console.hpp"
+
+// Clock of the SAMD21, to convert the benchmark durations to cycles
+#define METRICS_CPU_MHZ 48
+
+DerivedMetrics metrics = { INVALID_HUNDREDTHS, INVALID_HUNDREDTHS, INVALID_HUNDREDTHS, false };
+
+// ln(x) for x = 0.5 to 1 by steps of 0.005, in Q12
+static const int16_t lnTable[101] =
+{
+  -2839, -2798, -2758, -2718, -2678, -2639, -2600, -2562, -2524, -2486,
+  -2449, -2412, -2375, -2339, -2302, -2267, -2231, -2196, -2161, -2127,
+  -2092, -2058, -2025, -1991, -1958, -1925, -1892, -1860, -1828, -1796,
+  -1764, -1733, -1702, -1671, -1640, -1610, -1580, -1550, -1520, -1490,
+  -1461, -1432, -1403, -1374, -1346, -1317, -1289, -1261, -1233, -1206,
+  -1178, -1151, -1124, -1097, -1071, -1044, -1018, -992, -966, -940,
+  -914, -888, -863, -838, -813, -788, -763, -739, -714, -690,
+  -666, -642, -618, -594, -570, -547, -524, -500, -477, -454,
+  -432, -409, -386, -364, -342, -319, -297, -275, -253, -232,
+  -210, -189, -167, -146, -125, -104, -83, -62, -41, -21,
+  0
+};
+
+// Saturation vapour pressure over water for T = -40 to 85 degrees C, in Pa
+static const uint16_t saturationPressure[126] =
+{
+  19, 21, 23, 26, 29, 32, 35, 38, 42, 47,
+  51, 56, 62, 68, 74, 81, 89, 97, 106, 116,
+  126, 137, 149, 163, 177, 192, 208, 226, 245, 265,
+  287, 310, 336, 363, 391, 422, 455, 490, 528, 568,
+  611, 657, 706, 758, 813, 872, 934, 1001, 1071, 1146,
+  1226, 1310, 1400, 1495, 1595, 1702, 1814, 1933, 2059, 2192,
+  2333, 2481, 2637, 2803, 2977, 3160, 3353, 3557, 3771, 3997,
+  4234, 4483, 4745, 5020, 5309, 5613, 5931, 6265, 6616, 6983,
+  7367, 7770, 8192, 8634, 9096, 9580, 10085, 10614, 11166, 11743,
+  12345, 12974, 13630, 14315, 15029, 15774, 16550, 17359, 18202, 19080,
+  19993, 20944, 21934, 22963, 24034, 25147, 26304, 27506, 28754, 30051,
+  31398, 32795, 34246, 35751, 37311, 38930, 40608, 42347, 44149, 46015,
+  47949, 49951, 52023, 54168, 56387, 58683
+};
+
+/**
+ * @brief Saturates a value in hundredths to the range of an int16_t, INVALID_HUNDREDTHS excluded.
+ */
+static int16_t saturate(int64_t value)
+{
+  return constrain(value, -32767, 32767);
+}
+
+/**
+ * @brief Converts a reading to hundredths.
+ *
+ * @param value The reading.
+ *
+ * @return The reading in hundredths, INVALID_HUNDREDTHS if it is not a number or out of range.
+ */
+int16_t toHundredths(float value)
+{
+  if (!(value > -320.0f && value < 320.0f))
+  {
+    return INVALID_HUNDREDTHS;
+  }
+  return (int16_t)(value * 100.0f + (value < 0 ? -0.5f : 0.5f));
+}
+
+/**
+ * @brief Computes the dew point.
+ *
+ * @param temperature The temperature, in 0.01 degree C.
+ * @param humidity The relative humidity, in 0.01 %, clamped to 1 - 100 %.
+ *
+ * @return The dew point, in 0.01 degree C.
+ */
+int16_t dewPoint(int16_t temperature, int16_t humidity)
+{
+  if (temperature == INVALID_HUNDREDTHS || humidity == INVALID_HUNDREDTHS)
+  {
+    return INVALID_HUNDREDTHS;
+  }
+  int32_t rh = constrain(humidity, 100, 10000);
+  int32_t t = constrain(temperature, -4000, 12500);
+
+  // ln(RH / 100) = ln(2^k RH / 100) - k ln(2), with 2^k RH in 50 - 100 %
+  int32_t ln = 0;
+  while (rh < 5000)
+  {
+    rh *= 2;
+    ln -= 2839;
+  }
+  int32_t index = (rh - 5000) / 50;
+  ln += index == 100 ? 0 : lnTable[index] + (lnTable[index + 1] - lnTable[index]) * ((rh - 5000) % 50) / 50;
+
+  // gamma = ln(RH / 100) + b T / (c + T), in Q12
+  int32_t ratio = 1762 * t * 64 / (24312 + t);
+  int32_t gamma = ln + ratio * 16 / 25;
+
+  // Td = c gamma / (b - gamma), with b = 72172 in Q12
+  return 24312 * gamma / (72172 - gamma);
+}
+
+/**
+ * @brief Computes the absolute humidity.
+ *
+ * @param temperature The temperature, in 0.01 degree C, clamped to -40 - 85 degrees C.
+ * @param humidity The relative humidity, in 0.01 %.
+ *
+ * @return The absolute humidity, in 0.01 g/m3, saturated at 327.67 g/m3.
+ */
+int16_t absoluteHumidity(int16_t temperature, int16_t humidity)
+{
+  if (temperature == INVALID_HUNDREDTHS || humidity == INVALID_HUNDREDTHS)
+  {
+    return INVALID_HUNDREDTHS;
+  }
+  int32_t rh = constrain(humidity, 0, 10000);
+  int32_t t = constrain(temperature, -4000, 8500);
+
+  int32_t index = (t + 4000) / 100;
+  int32_t pressure = index == 125 ? saturationPressure[125]
+    : saturationPressure[index] + (saturationPressure[index + 1] - saturationPressure[index]) * ((t + 4000) % 100) / 100;
+
+  // AH = 2.1674 e / (273.15 + T) in g/m3, with e = es RH / 100 in Pa
+  return saturate((int64_t)pressure * rh * 21674 / (10000LL * (t + 27315)));
+}
+
+/**
+ * @brief Computes the heat index.
+ *
+ * @param temperature The temperature, in 0.01 degree C.
+ * @param humidity The relative humidity, in 0.01 %.
+ *
+ * @return The heat index, in 0.01 degree C, saturated at 327.67 degrees C.
+ */
+int16_t heatIndex(int16_t temperature, int16_t humidity)
+{
+  if (temperature == INVALID_HUNDREDTHS || humidity == INVALID_HUNDREDTHS)
+  {
+    return INVALID_HUNDREDTHS;
+  }
+  int64_t rh = constrain(humidity, 0, 10000);
+  int64_t t = (int32_t)temperature * 9 / 5 + 3200;
+
+  // Simple formula, in 0.01 degree F
+  int64_t index = (t + 6100 + (t - 6800) * 12 / 10 + rh * 94 / 1000) / 2;
+  if ((index + t) / 2 >= 8000)
+  {
+    // Regression of Rothfusz, each coefficient scaled to hundredths in and out
+    index = -4238
+      + t * 204901523 / 100000000
+      + rh * 1014333127 / 100000000
+      - t * rh * 22475541 / 10000000000LL
+      - t * t * 683783 / 10000000000LL
+      - rh * rh * 5481717 / 10000000000LL
+      + t * t * rh * 122874 / 1000000000000LL
+      + t * rh * rh * 85282 / 1000000000000LL
+      - t * t * rh * rh * 199 / 100000000000000LL;
+  }
+  return saturate((index - 3200) * 5 / 9);
+}
+
+/**
+ * @brief Queues a change of the condensation alarm.
+ */
+static void queueCondensationAlarm(int16_t temperature)
+{
+  uint8_t alarm[6] =
+  {
+    ALARM_CONDENSATION, metrics.condensation,
+    (uint8_t)((uint16_t)temperature >> 8), (uint8_t)((uint16_t)temperature & 0xFF),
+    (uint8_t)((uint16_t)metrics.dewPoint >> 8), (uint8_t)((uint16_t)metrics.dewPoint & 0xFF)
+  };
+  queueUplink(UPLINK_ALARM, PRIORITY_ALARM, alarm, sizeof(alarm));
+  console.println(metrics.condensation ? "Condensation alarm raised" : "Condensation alarm cleared");
+}
+
+/**
+ * @brief Computes the metrics of a sample and updates the condensation alarm.
+ *
+ * @param temperature The temperature, in 0.01 degree C.
+ * @param humidity The relative humidity, in 0.01 %.
+ */
+void updateMetrics(int16_t temperature, int16_t humidity)
+{
+  metrics.dewPoint = dewPoint(temperature, humidity);
+  metrics.absoluteHumidity = absoluteHumidity(temperature, humidity);
+  metrics.heatIndex = heatIndex(temperature, humidity);
+  if (metrics.dewPoint == INVALID_HUNDREDTHS)
+  {
+    return;
+  }
+
+  int32_t margin = (int32_t)temperature - metrics.dewPoint;
+  if (!metrics.condensation && margin < Config::CONDENSATION_MARGIN)
+  {
+    metrics.condensation = true;
+    queueCondensationAlarm(temperature);
+  }
+  else if (metrics.condensation && margin > Config::CONDENSATION_MARGIN + Config::CONDENSATION_HYSTERESIS)
+  {
+    metrics.condensation = false;
+    queueCondensationAlarm(temperature);
+  }
+}
+
+/**
+ * @brief Float reference of the dew point, in degrees C.
+ */
+static float dewPointFloat(float t, float rh)
+{
+  float gamma = logf(rh / 100.0f) + 17.62f * t / (243.12f + t);
+  return 243.12f * gamma / (17.62f - gamma);
+}
+
+/**
+ * @brief Float reference of the absolute humidity, in g/m3.
+ */
+static float absoluteHumidityFloat(float t, float rh)
+{
+  return 6.112f * expf(17.62f * t / (243.12f + t)) * rh * 2.1674f / (273.15f + t);
+}
+
+/**
+ * @brief Float reference of the heat index, in degrees C.
+ */
+static float heatIndexFloat(float t, float rh)
+{
+  float f = t * 1.8f + 32.0f;
+  float index = 0.5f * (f + 61.0f + (f - 68.0f) * 1.2f + rh * 0.094f);
+  if ((index + f) / 2.0f >= 80.0f)
+  {
+    index = -42.379f + 2.04901523f * f + 10.14333127f * rh - 0.22475541f * f * rh - 0.00683783f * f * f
+      - 0.05481717f * rh * rh + 0.00122874f * f * f * rh + 0.00085282f * f * rh * rh - 0.00000199f * f * f * rh * rh;
+  }
+  return (index - 32.0f) / 1.8f;
+}
+
+/**
+ * @brief Compares a fixed-point metric with its float reference and prints the result.
+ *
+ * The inputs sweep -40 to 85 degrees C by 0.5 degree and 1 to 100 % by 1 %.
+ * The references out of the range of toHundredths(), where the fixed-point
+ * metric saturates (absolute humidity above 320 g/m3 near 85 degrees C,
+ * heat index above 320 degrees C), are not compared: they are only counted,
+ * and the fixed-point result must then be saturated too.
+ *
+ * @param name The name of the metric.
+ * @param fixed The fixed-point function.
+ * @param reference The float reference.
+ */
+static void benchmarkMetric(const char *name, int16_t (*fixed)(int16_t, int16_t), float (*reference)(float, float))
+{
+  volatile int32_t sink = 0;
+  int32_t maxError = 0;
+  unsigned long count = 0;
+  unsigned long outOfRange = 0;
+  unsigned long unsaturated = 0;
+
+  for (int16_t t = -4000; t <= 8500; t += 50)
+  {
+    for (int16_t rh = 100; rh <= 10000; rh += 100)
+    {
+      int16_t value = fixed(t, rh);
+      int16_t expected = toHundredths(reference(t / 100.0f, rh / 100.0f));
+      count ++;
+      if (expected == INVALID_HUNDREDTHS)
+      {
+        outOfRange ++;
+        // Above 320.00, the fixed-point metric may still be in range up to its saturation at 327.67
+        if (abs(value) < 32000)
+        {
+          unsaturated ++;
+        }
+        continue;
+      }
+      int32_t error = abs(value - expected);
+      maxError = max(maxError, error);
+    }
+  }
+
+  unsigned long start = micros();
+  for (int16_t t = -4000; t <= 8500; t += 50)
+  {
+    for (int16_t rh = 100; rh <= 10000; rh += 100)
+    {
+      sink = sink + fixed(t, rh);
+    }
+  }
+  unsigned long fixedUs = micros() - start;
+
+  start = micros();
+  for (int16_t t = -4000; t <= 8500; t += 50)
+  {
+    for (int16_t rh = 100; rh <= 10000; rh += 100)
+    {
+      sink = sink + reference(t / 100.0f, rh / 100.0f);
+    }
+  }
+  unsigned long floatUs = micros() - start;
+
+  console.print("METRICS ");
+  console.print(name);
+  console.print(" max_error=");
+  console.print(maxError);
+  console.print(" out_of_range=");
+  console.print(outOfRange);
+  console.print(" unsaturated=");
+  console.print(unsaturated);
+  console.print(" fixed_cycles=");
+  console.print(fixedUs * METRICS_CPU_MHZ / count);
+  console.print(" float_cycles=");
+  console.println(floatUs * METRICS_CPU_MHZ / count);
+}
+
+/**
+ * @brief Runs the benchmark of the derived metrics if Config::METRICS_BENCHMARK is enabled.
+ *
+ * The durations include the loop and the conversions of the inputs.
+ */
+void init_Metrics()
+{
+  if (Config::METRICS_BENCHMARK)
+  {
+    benchmarkMetric("dew_point", dewPoint, dewPointFloat);
+    benchmarkMetric("absolute_humidity", absoluteHumidity, absoluteHumidityFloat);
+    benchmarkMetric("heat_index", heatIndex, heatIndexFloat);
+  }
+}
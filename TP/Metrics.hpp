@@ -0,0 +1,62 @@
+/*
+ * File: Metrics.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the derived metrics of a
+ * sample: dew point, absolute humidity and heat index, computed in fixed
+ * point from the temperature and humidity in hundredths, so that the
+ * condensation risk is detected on the node without a round trip to the
+ * backend.
+ *
+ * A condensation alarm is raised when the temperature gets closer than
+ * Config::CONDENSATION_MARGIN to the dew point, and cleared once it is
+ * Config::CONDENSATION_HYSTERESIS further. Each change is queued as an
+ * UPLINK_ALARM record of PRIORITY_ALARM:
+ * - byte 0: alarm, ALARM_CONDENSATION
+ * - byte 1: 1 when raised, 0 when cleared
+ * - bytes 2-3: temperature, in 0.01 degree C (big-endian)
+ * - bytes 4-5: dew point, in 0.01 degree C (big-endian)
+ *
+ * With Config::METRICS_BENCHMARK, the fixed-point functions are compared
+ * at boot with their float references over the range of the sensor, and
+ * their maximum error and duration are printed on the console.
+ *
+ * Functions:
+ * - init_Metrics: Runs the benchmark if enabled.
+ * - toHundredths: Converts a reading to hundredths.
+ * - dewPoint: Computes the dew point.
+ * - absoluteHumidity: Computes the absolute humidity.
+ * - heatIndex: Computes the heat index.
+ * - updateMetrics: Computes the metrics of a sample and updates the alarm.
+ */
+
+#ifndef HPP__METRICS__HPP
+#define HPP__METRICS__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+#include "FixedPoint.hpp"
+
+
+// Alarms
+#define ALARM_CONDENSATION 0x01
+
+// Derived metrics of the last sample, in hundredths of their unit.
+struct DerivedMetrics
+{
+  int16_t dewPoint;
+  int16_t absoluteHumidity;
+  int16_t heatIndex;
+  bool condensation;
+};
+
+extern DerivedMetrics metrics;
+
+void init_Metrics();
+int16_t toHundredths(float value);
+int16_t dewPoint(int16_t temperature, int16_t humidity);
+int16_t absoluteHumidity(int16_t temperature, int16_t humidity);
+int16_t heatIndex(int16_t temperature, int16_t humidity);
+void updateMetrics(int16_t temperature, int16_t humidity);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * File: Profiler.cpp
+ *
+ * Description:
+ * This source file implements the boot profiler. Each phase between
+ * power-on and the first successful uplink is timestamped with millis(),
+ * which starts from zero at the reset.
+ *
+ * A phase which is attempted several times (for instance the join) keeps
+ * the start of its first attempt and the end of its first success.
+ *
+ * Functions:
+ * - init_Profiler: Saves the profile of the previous boot and starts a new one.
+ * - profileStart: Records the start of a boot phase.
+ * - profileEnd: Records the end of a boot phase.
+ * - printBootProfile: Prints the profiles of the current and previous boots.
+ *
+ * Note:
+ * The report is printed one phase per line, in the format parsed by
+ * tools/boot_benchmark.py:
+ *   BOOT <boot count> <phase> start=<ms> duration=<ms>
+ */
+
+#include "Profiler.hpp"
+
+// Profile of the current boot, kept across warm resets (see tools/noinit.ld).
+static BootProfile currentProfile __attribute__((section(".noinit")));
+
+// Profile of the previous boot, valid if its magic number is set.
+static BootProfile previousProfile;
+
+// Names of the phases, as printed in the report.
+static const char *const phaseNames[PHASE_COUNT] =
+{
+  "console_init",
+  "modem_begin",
+  "sensor_begin",
+  "nvm_read",
+  "nvm_init",
+  "credentials",
+  "nvm_save",
+  "join",
+  "first_tx"
+};
+
+/**
+ * @brief Saves the profile of the previous boot and starts a new one.
+ *
+ * Must be called first in setup(), before any other phase is recorded.
+ */
+void init_Profiler()
+{
+  uint32_t bootCount = 0;
+  previousProfile.magic = 0;
+
+  if(currentProfile.magic == PROFILE_MAGIC)
+  {
+    previousProfile = currentProfile;
+    bootCount = currentProfile.bootCount + 1;
+  }
+
+  memset(&currentProfile, 0, sizeof(currentProfile));
+  currentProfile.magic = PROFILE_MAGIC;
+  currentProfile.bootCount = bootCount;
+}
+
+/**
+ * @brief Records the start of a boot phase, unless it already started.
+ *
+ * @param phase The phase starting.
+ */
+void profileStart(BootPhase phase)
+{
+  if(currentProfile.start[phase] == 0 && currentProfile.end[phase] == 0)
+  {
+    // A phase starting at the very first millisecond is recorded as 1 ms
+    currentProfile.start[phase] = millis() > 0 ? millis() : 1;
+  }
+}
+
+/**
+ * @brief Records the end of a boot phase, unless it already ended.
+ *
+ * @param phase The phase ending.
+ */
+void profileEnd(BootPhase phase)
+{
+  if(currentProfile.end[phase] == 0)
+  {
+    // Like its start, a phase ending at the very first millisecond is recorded as 1 ms
+    currentProfile.end[phase] = millis() > 0 ? millis() : 1;
+  }
+}
+
+/**
+ * @brief Prints a boot profile on the console.
+ *
+ * Phases that were not reached are omitted.
+ *
+ * @param profile The profile to print.
+ */
+static void printProfile(const BootProfile &profile)
+{
+  for(int i = 0; i < PHASE_COUNT; i++)
+  {
+    if(profile.end[i] != 0)
+    {
+      console.print("BOOT ");
+      console.print(profile.bootCount);
+      console.print(" ");
+      console.print(phaseNames[i]);
+      console.print(" start=");
+      console.print(profile.start[i]);
+      console.print(" duration=");
+      console.println(profile.end[i] - profile.start[i]);
+    }
+  }
+}
+
+/**
+ * @brief Prints the profiles of the current and previous boots.
+ *
+ * The end of the first uplink is the time to first uplink.
+ */
+void printBootProfile()
+{
+  if(previousProfile.magic == PROFILE_MAGIC)
+  {
+    console.println("Previous boot profile (ms):");
+    printProfile(previousProfile);
+  }
+  console.println("Boot profile (ms):");
+  printProfile(currentProfile);
+  console.print("Time to first uplink (ms): ");
+  console.println(currentProfile.end[PHASE_FIRST_TX]);
+}
@@ -0,0 +1,57 @@
+/*
+ * File: Profiler.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the boot profiler. It
+ * timestamps each phase between power-on and the first successful
+ * uplink, so that startup optimizations can be measured.
+ *
+ * The profile of the current boot is kept in a RAM section that is not
+ * cleared at startup: after a warm reset, the profile of the previous
+ * boot is still available and is reported along with the current one.
+ *
+ * Functions:
+ * - init_Profiler: Saves the profile of the previous boot and starts a new one.
+ * - profileStart: Records the start of a boot phase.
+ * - profileEnd: Records the end of a boot phase.
+ * - printBootProfile: Prints the profiles of the current and previous boots.
+ */
+
+#ifndef HPP__PROFILER__HPP
+#define HPP__PROFILER__HPP
+
+#include <Arduino.h>
+#include "Console.hpp"
+
+#define PROFILE_MAGIC 0x50524F47UL
+
+// Phases of the boot, in their order of execution.
+enum BootPhase
+{
+  PHASE_CONSOLE_INIT,
+  PHASE_MODEM_BEGIN,
+  PHASE_SENSOR_BEGIN,
+  PHASE_NVM_READ,
+  PHASE_NVM_INIT,
+  PHASE_CREDENTIALS,
+  PHASE_NVM_SAVE,
+  PHASE_JOIN,
+  PHASE_FIRST_TX,
+  PHASE_COUNT
+};
+
+// Timestamps of the boot phases, in milliseconds since the reset.
+struct BootProfile
+{
+  uint32_t magic;
+  uint32_t bootCount;
+  uint32_t start[PHASE_COUNT];
+  uint32_t end[PHASE_COUNT];
+};
+
+void init_Profiler();
+void profileStart(BootPhase phase);
+void profileEnd(BootPhase phase);
+void printBootProfile();
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * File: Redundancy.cpp
+ *
+ * Description:
+ * This source file implements the forward error correction of the data
+ * records: the samples of the last Config::DATA_PARITY_DEPTH records are
+ * kept in a ring, and their XOR is queued after each new record. The
+ * format is described in Redundancy.hpp.
+ *
+ * Functions:
+ * - queueDataRecord: Queues a data record and the parity of the previous ones.
+ *
+ * Note:
+ * The parity is queued with the priority of the data, right after it, so
+ * that both are packed into the same frame when they fit.
+ */
+
+#include "Redundancy.hpp"
+#include "Uplink.hpp"
+
+#define PARITY_SAMPLES_SIZE (configDataRecordSize() - DATA_SEQUENCE_SIZE)
+#define PARITY_RING_LENGTH (Config::DATA_PARITY_DEPTH > 0 ? Config::DATA_PARITY_DEPTH : 1)
+
+// Previous data records, the oldest at ringIndex once the ring is full.
+static uint8_t ring[PARITY_RING_LENGTH][configDataRecordSize()];
+static uint8_t ringIndex = 0;
+static uint8_t ringCount = 0;
+
+/**
+ * @brief Queues a data record and the parity of the previous ones.
+ *
+ * The parity is only queued once Config::DATA_PARITY_DEPTH records have
+ * been queued since the reset.
+ *
+ * @param record The data record, sequence number then samples.
+ * @param length The length of the record, configDataRecordSize() bytes.
+ *
+ * @return true if the data record is queued.
+ */
+bool queueDataRecord(const uint8_t record[], size_t length)
+{
+  bool queued = queueUplink(UPLINK_DATA, PRIORITY_DATA, record, length);
+  if (Config::DATA_PARITY_DEPTH == 0 || length != sizeof(ring[0]))
+  {
+    return queued;
+  }
+
+  if (ringCount == Config::DATA_PARITY_DEPTH)
+  {
+    uint8_t parity[configParityRecordSize()];
+    memcpy(parity, ring[ringIndex], DATA_SEQUENCE_SIZE);
+    parity[DATA_SEQUENCE_SIZE] = Config::DATA_PARITY_DEPTH;
+    memset(&parity[DATA_SEQUENCE_SIZE + 1], 0, PARITY_SAMPLES_SIZE);
+    for (int i = 0; i < Config::DATA_PARITY_DEPTH; i++)
+    {
+      for (int j = 0; j < PARITY_SAMPLES_SIZE; j++)
+      {
+        parity[DATA_SEQUENCE_SIZE + 1 + j] ^= ring[i][DATA_SEQUENCE_SIZE + j];
+      }
+    }
+    queueUplink(UPLINK_PARITY, PRIORITY_DATA, parity, sizeof(parity));
+  }
+  else
+  {
+    ringCount ++;
+  }
+
+  memcpy(ring[ringIndex], record, length);
+  ringIndex = (ringIndex + 1) % PARITY_RING_LENGTH;
+  return queued;
+}
@@ -0,0 +1,32 @@
+/*
+ * File: Redundancy.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the forward error
+ * correction of the data records. With Config::DATA_PARITY_DEPTH set to
+ * K > 0, each data record is followed by an UPLINK_PARITY record holding
+ * the XOR of the samples of the K previous data records: the decoder
+ * rebuilds any single record lost among them without a retransmission.
+ *
+ * Parity record format:
+ * - bytes 0-3: sequence number of the first sample of the oldest record (big-endian)
+ * - byte 4: number of records covered, K
+ * - then the XOR of the K records after their sequence number (sample
+ *   flags and samples)
+ * The covered records start BATCH_SIZE sequence numbers apart.
+ *
+ * Functions:
+ * - queueDataRecord: Queues a data record and the parity of the previous ones.
+ */
+
+#ifndef HPP__REDUNDANCY__HPP
+#define HPP__REDUNDANCY__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+static_assert(configParityRecordSize() <= Config::UPLINK_MESSAGE_MAX_LENGTH, "A parity record exceeds UPLINK_MESSAGE_MAX_LENGTH");
+
+bool queueDataRecord(const uint8_t record[], size_t length);
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * File: Scheduler.cpp
+ *
+ * Description:
+ * This source file implements a cooperative scheduler running the tasks
+ * of the node from loop(). A task is a function called once after a
+ * delay, or periodically. Tasks never preempt each other: each one runs
+ * to completion.
+ *
+ * Functions:
+ * - init_Scheduler: Clears the task table.
+ * - addTask: Registers a one-shot or periodic task.
+ * - rescheduleTask: Changes the next run time of a task.
+ * - stopTask: Removes a task from the table.
+ * - runScheduler: Runs the tasks that are due.
+ * - timeUntilNextTask: Returns the delay until the next task is due.
+ *
+ * Note:
+ * Times are compared with the difference of millis() values, so the
+ * scheduler keeps working when millis() wraps around after 49 days.
+ */
+
+#include <limits.h>
+#include "Scheduler.hpp"
+
+// Entry of the task table
+struct Task
+{
+  TaskFunction function;
+  unsigned long periodMs;
+  unsigned long nextRun;
+};
+
+// Table of the registered tasks, a null function marks a free entry.
+static Task tasks[SCHEDULER_MAX_TASKS];
+
+/**
+ * @brief Clears the task table.
+ */
+void init_Scheduler()
+{
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+  {
+    tasks[i].function = NULL;
+  }
+}
+
+/**
+ * @brief Registers a task.
+ *
+ * @param function The function run by the task.
+ * @param delayMs The delay before the first run, in milliseconds.
+ * @param periodMs The period of the task in milliseconds, 0 for a one-shot task.
+ *
+ * @return The identifier of the task, or SCHEDULER_NO_TASK if the table is full.
+ */
+int addTask(TaskFunction function, unsigned long delayMs, unsigned long periodMs)
+{
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+  {
+    if (tasks[i].function == NULL)
+    {
+      tasks[i].function = function;
+      tasks[i].periodMs = periodMs;
+      tasks[i].nextRun = millis() + delayMs;
+      return i;
+    }
+  }
+  return SCHEDULER_NO_TASK;
+}
+
+/**
+ * @brief Changes the next run time of a task.
+ *
+ * A periodic task keeps its period, counted from this new run time.
+ *
+ * @param task The identifier returned by addTask().
+ * @param delayMs The delay before the next run, in milliseconds.
+ */
+void rescheduleTask(int task, unsigned long delayMs)
+{
+  if (task >= 0 && task < SCHEDULER_MAX_TASKS && tasks[task].function != NULL)
+  {
+    tasks[task].nextRun = millis() + delayMs;
+  }
+}
+
+/**
+ * @brief Removes a task from the table.
+ *
+ * @param task The identifier returned by addTask().
+ */
+void stopTask(int task)
+{
+  if (task >= 0 && task < SCHEDULER_MAX_TASKS)
+  {
+    tasks[task].function = NULL;
+  }
+}
+
+/**
+ * @brief Runs the tasks that are due.
+ *
+ * Each due task is run once. A one-shot task is removed before it runs,
+ * so that it can register itself again. A periodic task is rescheduled
+ * one period after its theoretical run time, so that its period does
+ * not drift with the duration of the other tasks.
+ */
+void runScheduler()
+{
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+  {
+    TaskFunction function = tasks[i].function;
+
+    if (function != NULL && (long)(millis() - tasks[i].nextRun) >= 0)
+    {
+      if (tasks[i].periodMs == 0)
+      {
+        tasks[i].function = NULL;
+      }
+      else
+      {
+        tasks[i].nextRun += tasks[i].periodMs;
+        // Skip the periods missed by a late task instead of running it in a burst
+        if ((long)(millis() - tasks[i].nextRun) >= 0)
+        {
+          tasks[i].nextRun = millis() + tasks[i].periodMs;
+        }
+      }
+      function();
+    }
+  }
+}
+
+/**
+ * @brief Returns the delay until the next task is due.
+ *
+ * @return The delay in milliseconds, 0 if a task is already due, or
+ *         ULONG_MAX if no task is registered.
+ */
+unsigned long timeUntilNextTask()
+{
+  unsigned long delayMs = ULONG_MAX;
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+  {
+    if (tasks[i].function != NULL)
+    {
+      long remaining = (long)(tasks[i].nextRun - millis());
+      if (remaining <= 0)
+      {
+        return 0;
+      }
+      if ((unsigned long)remaining < delayMs)
+      {
+        delayMs = remaining;
+      }
+    }
+  }
+  return delayMs;
+}
\ No newline at end of file
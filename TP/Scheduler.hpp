@@ -0,0 +1,41 @@
+/*
+ * File: Scheduler.hpp
+ *
+ * Description:
+ * This header file contains the declaration of a cooperative scheduler
+ * running the tasks of the node from loop(). A task is a function called
+ * once after a delay, or periodically. Tasks never preempt each other:
+ * each one runs to completion, so independent steps are interleaved
+ * instead of waiting for each other with delay().
+ *
+ * Functions:
+ * - init_Scheduler: Clears the task table.
+ * - addTask: Registers a one-shot or periodic task.
+ * - rescheduleTask: Changes the next run time of a task.
+ * - stopTask: Removes a task from the table.
+ * - runScheduler: Runs the tasks that are due.
+ * - timeUntilNextTask: Returns the delay until the next task is due.
+ *
+ * Note:
+ * The task table has a fixed capacity of SCHEDULER_MAX_TASKS entries,
+ * no memory is allocated at runtime.
+ */
+
+#ifndef HPP__SCHEDULER__HPP
+#define HPP__SCHEDULER__HPP
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 12
+#define SCHEDULER_NO_TASK -1
+
+typedef void (*TaskFunction)();
+
+void init_Scheduler();
+int addTask(TaskFunction function, unsigned long delayMs, unsigned long periodMs);
+void rescheduleTask(int task, unsigned long delayMs);
+void stopTask(int task);
+void runScheduler();
+unsigned long timeUntilNextTask();
+
+#endif
\ No newline at end of file
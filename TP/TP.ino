@@ -3,56 +3,113 @@
 #include "Driver_SHT31.hpp"
 #include "Driver_LoRaWan.hpp"
 #include "Driver_Credentials.hpp"
+#include "Scheduler.hpp"
+#include "Boot.hpp"
+#include "Profiler.hpp"
+#include "Console.hpp"
+#include "Health.hpp"
+#include "Channels.hpp"
+#include "Uplink.hpp"
+#include "History.hpp"
+#include "Fragment.hpp"
+#include "Redundancy.hpp"
+#include "Metrics.hpp"
+#include "Heater.hpp"
 
-void setup() 
+// A sample is the raw temperature word followed by the raw humidity word of the
+// SHT31 (big-endian), converted by the decoder. The flags of the record hold four
+// bits per sample, in the low nibble of byte i / 2 for an even sample i and in
+// its high nibble for an odd one: bit 0 (SHT31_TEMPERATURE_VALID) and bit 1
+// (SHT31_HUMIDITY_VALID) are set when the word was read with a valid CRC, bit 2
+// (SAMPLE_HEATED) when the sample was taken during or right after a heater pulse.
+static_assert(Config::SAMPLE_SIZE == 2 * sizeof(uint16_t), "SAMPLE_SIZE must hold two 16-bit words");
+
+#define SAMPLE_HEATED 0x04
+
+/**
+ * @brief Application task, run every REPORT_INTERVAL_MS once the boot has completed.
+ *
+ * Reads a sample, records it in the history, updates the derived metrics and
+ * the condensation alarm unless the sample is heated, starts a heater pulse
+ * if the sensor is saturated, and queues the raw words of the batch once it holds
+ * BATCH_SIZE samples, after the sequence number of its first sample and the
+ * flags of the samples. The uplink scheduler connects if needed and sends it with the
+ * other queued messages.
+ */
+void sampleTask()
 {
-  // Initialize serial communication
-  Serial.begin(115200);
-  SerialLoRa.begin(19200);
-  while(!Serial && !SerialLoRa);
-  
-  //Initialize the LoRaWAN modem
-  init_LoRaWan();
-
-  //Initialize the SHT31 sensor
-  init_SHT31();
-
-  // Check if the credentials are already initialized
-  if(!credentialsAlreadyInit())
-  {
-    // Initialize the NVM to the initial state
-    writeNVM(0,MAGICNUMBER);
-    writeNVM(1,0);
-    writeNVM(2,MAGICNUMBER);
+  // Samples waiting to be queued, BATCH_SIZE samples per message
+  static uint8_t msg[configDataRecordSize()];
+  static uint8_t sampleCount = 0;
+
+  // Read the raw temperature and humidity words from the SHT31 sensor
+  uint16_t rawT;
+  uint16_t rawH;
+  bool heated = heaterAffects();
+  uint8_t valid = readSHT31Raw(rawT, rawH);
 
-    // Initialize credentials with AT commands
-    init_Credentials();
+  // The history and the metrics work in hundredths, and ignore the heated samples
+  int16_t t = valid & SHT31_TEMPERATURE_VALID ? sht31Temperature(rawT) : INVALID_HUNDREDTHS;
+  int16_t h = valid & SHT31_HUMIDITY_VALID ? sht31Humidity(rawH) : INVALID_HUNDREDTHS;
+  uint32_t sequence = heated ? recordSample(INVALID_HUNDREDTHS, INVALID_HUNDREDTHS) : recordSample(t, h);
+  if(Config::DERIVED_METRICS && !heated)
+  {
+    updateMetrics(t, h); // Dew point and condensation alarm
   }
-}
+  updateHeater(heated ? INVALID_HUNDREDTHS : h);
 
-void loop() 
-{
-  // Read the temperature and humidity from the SHT31 sensor
-  float t = sht31.readTemperature();
-  float h = sht31.readHumidity();
-  
-  // Convert the floats into byte arrays
-  uint8_t *bytePointerT = (uint8_t*)&t; 
-  uint8_t *bytePointerH = (uint8_t*)&h;
-
-  // Create a message array to send
-  char msg[8] = {bytePointerT[0],bytePointerT[1],bytePointerT[2],bytePointerT[3],bytePointerH[0],bytePointerH[1],bytePointerH[2],bytePointerH[3]};
-
-  // Check if the device is connected
-  if(!connected)
+  // The record starts with the big-endian sequence number of its first sample
+  uint8_t *flags = &msg[DATA_SEQUENCE_SIZE];
+  if(sampleCount == 0)
   {
-    connect();  // If not connected, try to connect
+    msg[0] = sequence >> 24;
+    msg[1] = (sequence >> 16) & 0xFF;
+    msg[2] = (sequence >> 8) & 0xFF;
+    msg[3] = sequence & 0xFF;
+    memset(flags, 0, configDataFlagsSize());
   }
-  else
+
+  // Append the raw words to the message
+  flags[sampleCount / 2] |= (valid | (heated ? SAMPLE_HEATED : 0)) << (4 * (sampleCount % 2));
+  uint8_t *sample = &msg[DATA_SEQUENCE_SIZE + configDataFlagsSize() + sampleCount * Config::SAMPLE_SIZE];
+  sample[0] = rawT >> 8;
+  sample[1] = rawT & 0xFF;
+  sample[2] = rawH >> 8;
+  sample[3] = rawH & 0xFF;
+  sampleCount ++;
+
+  if(sampleCount == Config::BATCH_SIZE)
   {
-    send(msg, sizeof(msg)); // Else, send the 8-byte message
+    queueDataRecord(msg, sizeof(msg)); // Queue the batch of samples, and its parity
+    sampleCount = 0;
   }
+}
 
-  delay(10000); // Wait 10 seconds before sending a new message for the duty cycle.
+void setup() 
+{
+  // Start the boot profile, the previous one is kept for the report
+  init_Profiler();
+
+  // Initialize serial communication, without waiting for a host on the console
+  profileStart(PHASE_CONSOLE_INIT);
+  init_Console();
+  SerialLoRa.begin(Config::MODEM_BAUDRATE);
+  profileEnd(PHASE_CONSOLE_INIT);
+
+  // Initialize the sensor and the modem, then sample every REPORT_INTERVAL_MS
+  init_Scheduler();
+  addTask(updateConsole, 0, CONSOLE_UPDATE_PERIOD_MS);
+  init_Boot(sampleTask, Config::REPORT_INTERVAL_MS);
+  init_Health();
+  init_Channels();
+  init_Uplink();
+  init_History();
+  init_Fragment();
+  init_Metrics();
 }
 
+void loop() 
+{
+  // Run the tasks that are due, the interval is checked against the duty cycle in Config.hpp.
+  runScheduler();
+}
\ No newline at end of file
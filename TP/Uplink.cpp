@@ -0,0 +1,421 @@
+/*
+ * File: Uplink.cpp
+ *
+ * Description:
+ * This source file implements the uplink scheduler: a fixed-size priority
+ * queue of messages, packed into frames of records up to the maximum
+ * payload of the current data rate, and sent within a duty cycle budget.
+ *
+ * Functions:
+ * - init_Uplink: Registers the uplink scheduler in the scheduler.
+ *   The scheduler also joins the network, with an exponential backoff.
+ * - queueUplink: Queues a message.
+ * - appendUplink: Appends a value to a queued message of the same type, or queues it.
+ * - replaceUplink: Replaces a queued message of the same type, or queues it.
+ * - packUplink: Packs the most urgent queued messages into a frame.
+ * - uplinkQueueLength: Returns the number of queued messages.
+ * - uplinkQueued: Indicates whether a message of a type is queued.
+ *
+ * Note:
+ * Messages are removed from the queue only once their frame is
+ * transmitted, a failed frame is packed again at the next attempt. The
+ * messages of the frame being sent are marked in flight: the downlinks
+ * dispatched during the transmission neither modify nor drop them.
+ */
+
+#include "Uplink.hpp"
+#include "Scheduler.hpp"
+#include "Boot.hpp"
+#include "Driver_LoRaWan.hpp"
+#include "Console.hpp"
+
+// Entry of the queue, a null length marks a free entry.
+struct UplinkMessage
+{
+  uint8_t type;
+  uint8_t priority;
+  uint8_t length;
+  unsigned long queued;
+  uint8_t data[Config::UPLINK_MESSAGE_MAX_LENGTH];
+};
+
+// Queued messages.
+static UplinkMessage queue[Config::UPLINK_QUEUE_LENGTH];
+
+// Messages packed into the frame being sent.
+static bool inFlight[Config::UPLINK_QUEUE_LENGTH];
+
+// Duty cycle budget in microseconds of airtime, and time of its last refill.
+static uint32_t budgetUs = UPLINK_BUDGET_WINDOW_MS * 10;
+static unsigned long budgetRefill = 0;
+
+// Delay before the next join attempt, 0 after a success, and time of the last attempt.
+static unsigned long joinBackoffMs = 0;
+static unsigned long lastJoinAttempt = 0;
+
+/**
+ * @brief Returns the priority of a queued message, improved by its waiting time.
+ *
+ * The bulk messages do not age: a long backfill would otherwise take the
+ * budget of the data and of the reserve.
+ *
+ * @param message The queued message.
+ */
+static uint8_t effectivePriority(const UplinkMessage &message)
+{
+  if (message.priority == PRIORITY_BULK)
+  {
+    return PRIORITY_BULK;
+  }
+  unsigned long levels = (millis() - message.queued) / Config::UPLINK_AGING_MS;
+  return levels >= message.priority ? 0 : message.priority - levels;
+}
+
+/**
+ * @brief Refills the duty cycle budget with 1 % of the elapsed time.
+ */
+static void refillBudget()
+{
+  unsigned long now = millis();
+  uint64_t budget = budgetUs + (uint64_t)(now - budgetRefill) * 10;
+  budgetRefill = now;
+  budgetUs = budget > UPLINK_BUDGET_WINDOW_MS * 10 ? UPLINK_BUDGET_WINDOW_MS * 10 : budget;
+}
+
+/**
+ * @brief Indicates whether a frame should be sent now.
+ *
+ * @param urgent Set to true if a message at least as urgent as the data is queued.
+ *
+ * @return true if a message is urgent or has waited Config::UPLINK_MAX_WAIT_MS.
+ */
+static bool uplinkDue(bool &urgent)
+{
+  bool due = false;
+  urgent = false;
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    if (queue[i].length == 0)
+    {
+      continue;
+    }
+    if (queue[i].priority != PRIORITY_ACK && effectivePriority(queue[i]) <= PRIORITY_DATA)
+    {
+      urgent = true;
+      due = true;
+    }
+    if (millis() - queue[i].queued >= Config::UPLINK_MAX_WAIT_MS)
+    {
+      due = true;
+    }
+  }
+  return due;
+}
+
+/**
+ * @brief Joins the network, unless the join backoff or the budget defers it.
+ *
+ * Each attempt is charged to the duty cycle budget with the airtime of a
+ * join request at Config::JOIN_DATA_RATE, the reserve being left to the
+ * urgent messages. A failed attempt doubles the delay before the next one,
+ * from Config::JOIN_BACKOFF_MIN_MS up to Config::JOIN_BACKOFF_MAX_MS, so
+ * that a node out of coverage neither blocks in connect() every second nor
+ * exhausts its duty cycle.
+ *
+ * @param reserveUs The part of the budget which must be left.
+ *
+ * @return true if the device is connected.
+ */
+static bool joinNetwork(uint32_t reserveUs)
+{
+  uint32_t airtimeUs = eu868JoinAirtimeUs(Config::JOIN_DATA_RATE);
+  if ((joinBackoffMs > 0 && millis() - lastJoinAttempt < joinBackoffMs) || budgetUs < airtimeUs + reserveUs)
+  {
+    return false;
+  }
+
+  budgetUs -= airtimeUs;
+  lastJoinAttempt = millis();
+  connect();
+  if (connected)
+  {
+    joinBackoffMs = 0;
+    return true;
+  }
+
+  joinBackoffMs = joinBackoffMs == 0 ? Config::JOIN_BACKOFF_MIN_MS : min(2 * joinBackoffMs, Config::JOIN_BACKOFF_MAX_MS);
+  console.print("Join failed, next attempt in (ms): ");
+  console.println(joinBackoffMs);
+  return false;
+}
+
+/**
+ * @brief Task sending the next frame when it is due and the budget allows it.
+ *
+ * Joins first if the device is not connected. Nothing is sent before
+ * the modem has been initialised by the boot steps.
+ */
+static void uplinkTask()
+{
+  refillBudget();
+
+  bool urgent;
+  if (!bootCompleted() || !uplinkDue(urgent))
+  {
+    return;
+  }
+
+  uint32_t reserveUs = UPLINK_BUDGET_WINDOW_MS / 10 * Config::UPLINK_RESERVE_PERCENT;
+  if (!connected && !joinNetwork(urgent ? 0 : reserveUs))
+  {
+    return;
+  }
+
+  // The link policy never selects a data rate faster than Config::DATA_RATE
+  uint8_t frame[eu868MaxPayload(Config::DATA_RATE)];
+  size_t size = packUplink(frame, eu868MaxPayload(dataRate), PRIORITY_BULK, inFlight);
+  uint32_t airtimeUs = eu868AirtimeUs(size, dataRate) * Config::TX_TRANSMISSIONS;
+  if (urgent && budgetUs < airtimeUs + reserveUs)
+  {
+    // Only the urgent messages may use the reserve
+    size = packUplink(frame, eu868MaxPayload(dataRate), PRIORITY_DATA, inFlight);
+    airtimeUs = eu868AirtimeUs(size, dataRate) * Config::TX_TRANSMISSIONS;
+    reserveUs = 0;
+  }
+
+  if (size > 0 && budgetUs >= airtimeUs + reserveUs)
+  {
+    budgetUs -= airtimeUs;
+    bool sent = send((char *)frame, size);
+    for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+    {
+      if (sent && inFlight[i])
+      {
+        queue[i].length = 0;
+      }
+    }
+  }
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    inFlight[i] = false;
+  }
+}
+
+/**
+ * @brief Returns the queued message of a type which may still be modified.
+ *
+ * @param type The record type.
+ *
+ * @return The index of the message, or -1 if none is queued out of flight.
+ */
+static int findUplink(uint8_t type)
+{
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    if (queue[i].length != 0 && !inFlight[i] && queue[i].type == type)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Registers the uplink scheduler in the scheduler.
+ */
+void init_Uplink()
+{
+  budgetRefill = millis();
+  addTask(uplinkTask, Config::UPLINK_CHECK_PERIOD_MS, Config::UPLINK_CHECK_PERIOD_MS);
+}
+
+/**
+ * @brief Queues a message.
+ *
+ * If the queue is full, the least urgent and oldest message is dropped to
+ * make room, unless it is more urgent than the new message. The messages
+ * in flight are never dropped.
+ *
+ * @param type The record type of the message.
+ * @param priority The priority of the message.
+ * @param data The value of the message.
+ * @param length The length of the value, at most Config::UPLINK_MESSAGE_MAX_LENGTH.
+ *
+ * @return true if the message is queued, false if it is dropped.
+ */
+bool queueUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length)
+{
+  if (length == 0 || length > Config::UPLINK_MESSAGE_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  int entry = -1;
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    if (queue[i].length == 0)
+    {
+      entry = i;
+      break;
+    }
+    if (inFlight[i])
+    {
+      continue;
+    }
+    if (entry < 0 || queue[i].priority > queue[entry].priority
+      || (queue[i].priority == queue[entry].priority && (long)(queue[entry].queued - queue[i].queued) > 0))
+    {
+      entry = i;
+    }
+  }
+
+  if (entry < 0 || queue[entry].length != 0)
+  {
+    if (entry < 0 || queue[entry].priority < priority)
+    {
+      console.println("Uplink queue full, message dropped");
+      return false;
+    }
+    console.println("Uplink queue full, oldest message dropped");
+  }
+
+  queue[entry].type = type;
+  queue[entry].priority = priority;
+  queue[entry].length = length;
+  queue[entry].queued = millis();
+  memcpy(queue[entry].data, data, length);
+  return true;
+}
+
+/**
+ * @brief Appends a value to a queued message of the same type, or queues it.
+ *
+ * Used for records made of a list of entries, such as acknowledgements,
+ * so that several entries share the two bytes of a record header.
+ *
+ * @param type The record type of the message.
+ * @param priority The priority of a new message.
+ * @param data The value to append.
+ * @param length The length of the value.
+ *
+ * @return true if the value is appended or queued, false if it is dropped.
+ */
+bool appendUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length)
+{
+  int entry = findUplink(type);
+  if (entry < 0 || queue[entry].length + length > Config::UPLINK_MESSAGE_MAX_LENGTH)
+  {
+    return queueUplink(type, priority, data, length);
+  }
+  memcpy(&queue[entry].data[queue[entry].length], data, length);
+  queue[entry].length += length;
+  return true;
+}
+
+/**
+ * @brief Replaces a queued message of the same type, or queues it.
+ *
+ * Used for records of which only the last value matters, such as the
+ * configuration digest. The replaced message keeps its queuing time.
+ *
+ * @param type The record type of the message.
+ * @param priority The priority of a new message.
+ * @param data The new value.
+ * @param length The length of the value, at most Config::UPLINK_MESSAGE_MAX_LENGTH.
+ *
+ * @return true if the message is replaced or queued, false if it is dropped.
+ */
+bool replaceUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length)
+{
+  int entry = findUplink(type);
+  if (entry < 0 || length == 0 || length > Config::UPLINK_MESSAGE_MAX_LENGTH)
+  {
+    return queueUplink(type, priority, data, length);
+  }
+  queue[entry].length = length;
+  memcpy(queue[entry].data, data, length);
+  return true;
+}
+
+/**
+ * @brief Packs the most urgent queued messages into a frame.
+ *
+ * The messages are taken from the most urgent to the least urgent, the
+ * oldest first among equals, skipping those which do not fit anymore.
+ *
+ * @param frame The buffer receiving the frame.
+ * @param maxSize The maximum size of the frame.
+ * @param lowest The least urgent priority to pack, after aging.
+ * @param select Set to true for each queue entry packed into the frame.
+ *
+ * @return The size of the frame, 0 if no message fits.
+ */
+size_t packUplink(uint8_t frame[], size_t maxSize, UplinkPriority lowest, bool select[])
+{
+  size_t size = 0;
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    select[i] = false;
+  }
+
+  while (true)
+  {
+    int best = -1;
+    for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+    {
+      if (queue[i].length == 0 || select[i] || effectivePriority(queue[i]) > lowest
+        || size + UPLINK_RECORD_HEADER_SIZE + queue[i].length > maxSize)
+      {
+        continue;
+      }
+      if (best < 0 || effectivePriority(queue[i]) < effectivePriority(queue[best])
+        || (effectivePriority(queue[i]) == effectivePriority(queue[best]) && (long)(queue[best].queued - queue[i].queued) > 0))
+      {
+        best = i;
+      }
+    }
+    if (best < 0)
+    {
+      return size;
+    }
+
+    select[best] = true;
+    frame[size++] = queue[best].type;
+    frame[size++] = queue[best].length;
+    memcpy(&frame[size], queue[best].data, queue[best].length);
+    size += queue[best].length;
+  }
+}
+
+/**
+ * @brief Returns the number of queued messages.
+ */
+uint8_t uplinkQueueLength()
+{
+  uint8_t count = 0;
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    if (queue[i].length != 0)
+    {
+      count ++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Indicates whether a message of a type is queued.
+ *
+ * @param type The record type.
+ */
+bool uplinkQueued(uint8_t type)
+{
+  for (int i = 0; i < Config::UPLINK_QUEUE_LENGTH; i++)
+  {
+    if (queue[i].length != 0 && queue[i].type == type)
+    {
+      return true;
+    }
+  }
+  return false;
+}
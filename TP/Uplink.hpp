@@ -0,0 +1,77 @@
+/*
+ * File: Uplink.hpp
+ *
+ * Description:
+ * This header file contains the declaration of the uplink scheduler. The
+ * modules do not send their messages directly: they queue them with a
+ * priority, and the scheduler packs several messages into each frame,
+ * up to the maximum payload of the current data rate.
+ *
+ * The next frame starts with the most urgent message, the priority of a
+ * message improving by one level every Config::UPLINK_AGING_MS it waits,
+ * except for the bulk messages which keep their priority.
+ * A frame is sent as soon as a message at least as urgent as the data is
+ * queued, or when a less urgent message has waited Config::UPLINK_MAX_WAIT_MS.
+ * Each frame is charged to a duty cycle budget, refilled at 1 % of the
+ * elapsed time: frames without urgent message keep a reserve of
+ * Config::UPLINK_RESERVE_PERCENT of the budget for the urgent ones. When
+ * the budget is short, a frame only carries the urgent messages.
+ *
+ * Frame format, sent on Config::UPLINK_PORT: a sequence of records
+ *   [type (1 byte)] [length (1 byte)] [value (length bytes)]
+ *
+ * Messages of PRIORITY_ACK (acknowledgements, configuration digest) are
+ * piggybacked: they are packed first into the next frame, but never make
+ * a frame due on their own before Config::UPLINK_MAX_WAIT_MS.
+ *
+ * Functions:
+ * - init_Uplink: Registers the uplink scheduler in the scheduler.
+ * - queueUplink: Queues a message.
+ * - appendUplink: Appends a value to a queued message of the same type, or queues it.
+ * - replaceUplink: Replaces a queued message of the same type, or queues it.
+ * - packUplink: Packs the most urgent queued messages into a frame.
+ * - uplinkQueueLength: Returns the number of queued messages.
+ * - uplinkQueued: Indicates whether a message of a type is queued.
+ */
+
+#ifndef HPP__UPLINK__HPP
+#define HPP__UPLINK__HPP
+
+#include <Arduino.h>
+#include "Config.hpp"
+
+// Record types
+#define UPLINK_DATA 0x01
+#define UPLINK_HEALTH 0x02
+#define UPLINK_ALARM 0x03
+#define UPLINK_ACK 0x04
+#define UPLINK_CONFIG 0x05
+#define UPLINK_HISTORY 0x06
+#define UPLINK_FRAGMENT 0x07
+#define UPLINK_PARITY 0x08
+
+// Priorities, from the most urgent
+enum UplinkPriority
+{
+  PRIORITY_ALARM,
+  PRIORITY_ACK,
+  PRIORITY_DATA,
+  PRIORITY_HEALTH,
+  PRIORITY_BULK
+};
+
+// Duty cycle budget window: the budget holds at most 1 % of it.
+#define UPLINK_BUDGET_WINDOW_MS 3600000UL
+
+static_assert(configDataRecordSize() <= Config::UPLINK_MESSAGE_MAX_LENGTH,
+  "A batch of samples exceeds UPLINK_MESSAGE_MAX_LENGTH");
+
+void init_Uplink();
+bool queueUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length);
+bool appendUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length);
+bool replaceUplink(uint8_t type, UplinkPriority priority, const uint8_t data[], size_t length);
+size_t packUplink(uint8_t frame[], size_t maxSize, UplinkPriority lowest, bool select[]);
+uint8_t uplinkQueueLength();
+bool uplinkQueued(uint8_t type);
+
+#endif
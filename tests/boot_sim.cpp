@@ -0,0 +1,223 @@
+/*
+ * File: boot_sim.cpp
+ *
+ * Description:
+ * Boots the firmware of the node (TP.ino and the TP sources) on the simulated
+ * board of tests/host, from the reset to the first acknowledged uplink,
+ * and prints its console. The boot profile printed by the firmware (see
+ * TP/Profiler.cpp) is aggregated over several runs by
+ * tools/boot_benchmark.py --simulator and tools/provision_bench.py.
+ *
+ * The credentials are either already saved in the NVM of the modem
+ * (--provisioned), or entered by a simulated production host:
+ * - interactive: AT+D, AT+A, AT+K and AT+S, each command sent once the
+ *   firmware has answered the previous one,
+ * - bulk: a single AT+P message (tools/provision.py), sent when the
+ *   console is opened, before the firmware asks for it.
+ * A factory build (-DNODE_CONFIG=FactoryProvisioningConfig) personalized
+ * by tools/factory_images.py reads them from its own image instead.
+ *
+ * Usage: boot_sim [--seed N] [--provisioned] [--flow interactive|bulk]
+ *                 [--uplinks N] [--frames] [--downlink N:HEX]
+ *                 [--<parameter> value ...] (see the options below)
+ *
+ * The simulation goes on after the first uplink until --uplinks uplinks
+ * (1 by default) are acknowledged, to exercise the sleep and wake up of
+ * the modem between uplinks. The exit status is 0 once they are, 1 if the
+ * simulated time limit (--limit-s, 600 s by default) is reached before.
+ *
+ * With --frames, each acknowledged uplink is printed on a line
+ * "UPLINK <port> <payload in hexadecimal>", the input of
+ * tools/decode_uplink.py. --downlink N:HEX queues a downlink (command
+ * byte first) in the RX windows of the Nth acknowledged uplink.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include "Simulator.hpp"
+#include "Scheduler.hpp"
+#include "Config.hpp"
+#include "Crc.hpp"
+
+void setup();
+void loop();
+
+// Credentials entered by the simulated production host
+#define DEV_EUI "0011223344556677"
+#define APP_EUI "70B3D57ED0000000"
+#define APP_KEY "000102030405060708090A0B0C0D0E0F"
+
+// Commands of the interactive flow, and the next one to send
+static const char *const interactiveCommands[] = { "AT+D=" DEV_EUI, "AT+A=" APP_EUI, "AT+K=" APP_KEY, "AT+S" };
+static const size_t INTERACTIVE_COMMAND_COUNT = sizeof(interactiveCommands) / sizeof(interactiveCommands[0]);
+static size_t nextCommand = 0;
+
+static bool interactive = false;
+static bool firstUplink = false;
+
+// Acknowledged uplinks, and the number after which the simulation ends
+static unsigned long uplinks = 0;
+static unsigned long uplinkTarget = 1;
+
+// Print the acknowledged uplinks
+static bool printFrames = false;
+
+// Downlinks of the scenario, and the uplink after which each one is received
+static std::vector<std::pair<unsigned long, std::vector<uint8_t> > > downlinks;
+
+/**
+ * @brief Counts the uplinks acknowledged by the network, and answers them.
+ */
+static void uplinkSent(uint8_t port, const uint8_t data[], size_t length)
+{
+  uplinks++;
+  if (printFrames)
+  {
+    printf("UPLINK %u ", port);
+    for (size_t i = 0; i < length; i++)
+    {
+      printf("%02X", data[i]);
+    }
+    printf("\n");
+  }
+  for (size_t i = 0; i < downlinks.size(); i++)
+  {
+    if (downlinks[i].first == uplinks)
+    {
+      sim::queueDownlink(downlinks[i].second.data(), downlinks[i].second.size());
+    }
+  }
+}
+
+/**
+ * @brief Parses a --downlink option, N:HEX.
+ *
+ * @return false if it is invalid.
+ */
+static bool parseDownlink(const char *value)
+{
+  char *end;
+  unsigned long after = strtoul(value, &end, 10);
+  if (*end != ':' || strlen(end + 1) % 2 != 0 || strlen(end + 1) == 0)
+  {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  for (const char *hex = end + 1; *hex != 0; hex += 2)
+  {
+    char byte[3] = { hex[0], hex[1], 0 };
+    data.push_back(strtoul(byte, NULL, 16));
+  }
+  downlinks.push_back(std::make_pair(after, data));
+  return true;
+}
+
+/**
+ * @brief Reacts to the console of the firmware, as the production host would.
+ */
+static void consoleLine(const char *line)
+{
+  if (strncmp(line, "Time to first uplink", 20) == 0)
+  {
+    firstUplink = true;
+  }
+
+  // The interactive host sends a command when the prompt or the answer to
+  // its previous command is printed
+  bool answer = strncmp(line, "Ready to receive AT commands", 28) == 0 || (nextCommand > 0 && strstr(line, " OK") != NULL);
+  if (interactive && answer && nextCommand < INTERACTIVE_COMMAND_COUNT)
+  {
+    sim::hostSend(interactiveCommands[nextCommand++]);
+  }
+}
+
+/**
+ * @brief Sends the AT+P message of the bulk flow, with its CRC.
+ */
+static void sendProvisioningMessage()
+{
+  const char body[] = DEV_EUI "," APP_EUI "," APP_KEY;
+  char message[sizeof(body) + 16];
+  snprintf(message, sizeof(message), "AT+P=%s,%04X", body, crc16Ccitt((const uint8_t *)body, strlen(body)));
+  sim::hostSend(message);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: boot_sim [--seed N] [--provisioned] [--flow interactive|bulk] [--uplinks N] [--limit-s S]\n"
+                  "  [--frames] [--downlink N:HEX]\n"
+                  "  [--quiet] [--trace-modem] [--jitter X] [--usb-latency-us US] [--modem-begin-ms MS] [--modem-begin-success P]\n"
+                  "  [--command-ms MS] [--nvm-read-ms MS] [--nvm-write-ms MS] [--wake-ms MS] [--drop-rate P]\n"
+                  "  [--join-ms MS] [--join-success P] [--channel-plan HEX] [--uplink-ms MS] [--uplink-success P]\n"
+                  "  [--sensor-walk HUNDREDTHS]\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+  sim::Parameters &p = sim::parameters;
+  std::string flow;
+  bool provisioned = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    if (option == "--provisioned") { provisioned = true; continue; }
+    if (option == "--quiet") { p.echo = false; continue; }
+    if (option == "--trace-modem") { p.traceModem = true; continue; }
+    if (option == "--frames") { printFrames = true; continue; }
+    if (i + 1 >= argc) usage();
+    const char *value = argv[++i];
+    if (option == "--seed") p.seed = strtoul(value, NULL, 10);
+    else if (option == "--flow") flow = value;
+    else if (option == "--uplinks") uplinkTarget = strtoul(value, NULL, 10);
+    else if (option == "--downlink") { if (!parseDownlink(value)) usage(); }
+    else if (option == "--limit-s") p.limitS = atof(value);
+    else if (option == "--jitter") p.jitter = atof(value);
+    else if (option == "--usb-latency-us") p.usbLatencyUs = strtoul(value, NULL, 10);
+    else if (option == "--modem-begin-ms") p.modemBeginMs = strtoul(value, NULL, 10);
+    else if (option == "--modem-begin-success") p.modemBeginSuccess = atof(value);
+    else if (option == "--command-ms") p.commandMs = strtoul(value, NULL, 10);
+    else if (option == "--nvm-read-ms") p.nvmReadMs = strtoul(value, NULL, 10);
+    else if (option == "--nvm-write-ms") p.nvmWriteMs = strtoul(value, NULL, 10);
+    else if (option == "--wake-ms") p.wakeMs = strtoul(value, NULL, 10);
+    else if (option == "--drop-rate") p.dropRate = atof(value);
+    else if (option == "--join-ms") p.joinMs = strtoul(value, NULL, 10);
+    else if (option == "--join-success") p.joinSuccess = atof(value);
+    else if (option == "--channel-plan") p.channelPlan = strtoul(value, NULL, 16);
+    else if (option == "--uplink-ms") p.uplinkMs = strtoul(value, NULL, 10);
+    else if (option == "--uplink-success") p.uplinkSuccess = atof(value);
+    else if (option == "--sensor-walk") p.sensorWalk = atoi(value);
+    else usage();
+  }
+
+  if (provisioned)
+  {
+    sim::modemNvm[0] = Config::MAGIC_NUMBER;
+    sim::modemNvm[1] = 1;
+    sim::modemNvm[2] = Config::MAGIC_NUMBER + 1;
+  }
+  interactive = flow == "interactive";
+  sim::consoleLine = consoleLine;
+  sim::uplinkSent = uplinkSent;
+  if (flow == "bulk")
+  {
+    sendProvisioningMessage();
+  }
+  else if (!flow.empty() && !interactive)
+  {
+    usage();
+  }
+
+  // The CPU sleeps until the next task is due
+  setup();
+  while (!firstUplink || uplinks < uplinkTarget)
+  {
+    loop();
+    sim::advance(min(timeUntilNextTask(), 1000UL) * 1000ULL);
+  }
+  return 0;
+}
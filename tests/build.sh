@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# File: build.sh
+#
+# Description:
+# Builds the host programs of the tests directory with g++: the firmware
+# of the node (TP.ino and TP/*.cpp) is compiled for the simulated board of
+# tests/host, with AddressSanitizer and UndefinedBehaviorSanitizer.
+# - boot_sim: boots the firmware up to its first uplink (boot_sim.cpp),
+# - boot_sim_factory_template: the same, built with FactoryProvisioningConfig,
+#   whose credentials record is left invalid (the console is used),
+# - boot_sim_factory: the template personalized by tools/factory_images.py
+#   with the credentials of boot_sim.cpp,
+# - boot_sim_edge: the same, built with EdgeOfCoverageConfig, whose history
+#   pages are fragmented and data records protected by parity (used by
+#   tests/decode_roundtrip.py).
+#
+# Usage: tests/build.sh
+# The programs are written to $BUILD_DIR (default /tmp/tp_host_build).
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=${BUILD_DIR:-/tmp/tp_host_build}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=gnu++11 -O1 -g -Wall -Wno-unused-parameter -fsanitize=address,undefined -fno-sanitize-recover=undefined"}
+
+mkdir -p "$BUILD_DIR"
+
+# Firmware sources, the sketch being C++
+FIRMWARE="-x c++ $ROOT/TP/TP.ino -x none $(ls "$ROOT"/TP/*.cpp)"
+INCLUDES="-I$ROOT/tests/host -I$ROOT/TP"
+
+$CXX $CXXFLAGS $INCLUDES -o "$BUILD_DIR/boot_sim" \
+  $FIRMWARE "$ROOT/tests/host/Simulator.cpp" "$ROOT/tests/boot_sim.cpp"
+$CXX $CXXFLAGS $INCLUDES -DNODE_CONFIG=FactoryProvisioningConfig -o "$BUILD_DIR/boot_sim_factory_template" \
+  $FIRMWARE "$ROOT/tests/host/Simulator.cpp" "$ROOT/tests/boot_sim.cpp"
+# The record of the factory image is a template: it is personalized as a
+# production image would be, the constant data of the program being its flash
+printf 'dev_eui,app_eui,app_key\n0011223344556677,70B3D57ED0000000,000102030405060708090A0B0C0D0E0F\n' \
+  > "$BUILD_DIR/factory_manifest.csv"
+python3 "$ROOT/tools/factory_images.py" "$BUILD_DIR/factory_manifest.csv" \
+  --image "$BUILD_DIR/boot_sim_factory_template" --output "$BUILD_DIR/factory_images" > /dev/null
+cp "$BUILD_DIR/factory_images/0011223344556677.bin" "$BUILD_DIR/boot_sim_factory"
+chmod +x "$BUILD_DIR/boot_sim_factory"
+$CXX $CXXFLAGS $INCLUDES -DNODE_CONFIG=EdgeOfCoverageConfig -o "$BUILD_DIR/boot_sim_edge" \
+  $FIRMWARE "$ROOT/tests/host/Simulator.cpp" "$ROOT/tests/boot_sim.cpp"
+
+echo "host programs built in $BUILD_DIR"
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+#
+# File: decode_roundtrip.py
+#
+# Description:
+# Round trip of the uplinks through tools/decode_uplink.py. The firmware
+# of the node, built for the simulated board with EdgeOfCoverageConfig
+# (boot_sim_edge, see tests/build.sh), runs for a few simulated days and
+# is asked to backfill its history, whose pages are fragmented at DR0. Its
+# frames are then decoded many times, each time with random frames lost
+# in between, and the test checks that:
+# - every history page reassembled from the fragments is one that was sent,
+# - pages are recovered from their parity fragments despite lost fragments,
+# - the same sessions decoded again, as after a reset of the node which
+#   restarts the session numbers, are reassembled again,
+# - every data record decoded, received or rebuilt from a parity record,
+#   is the one that was sent, and some lost records are rebuilt,
+# - the decoder keeps at most DATA_PARITY_DEPTH + 1 data records.
+#
+# The exit status is 0 if all the checks pass.
+#
+# Usage:
+#   tests/build.sh && tests/decode_roundtrip.py [--trials N] [--loss P] [--seed N]
+
+import argparse
+import os
+import random
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tools"))
+import decode_uplink  # noqa: E402
+
+SIMULATOR_ARGS = ["--provisioned", "--quiet", "--frames", "--sensor-walk", "20", "--uplinks", "400",
+                  "--limit-s", "1000000", "--downlink", "150:0200000000FFFFFFFF"]
+
+# DATA_PARITY_DEPTH of EdgeOfCoverageConfig
+PARITY_DEPTH = 4
+
+
+class RecordingDecoder(decode_uplink.Decoder):
+    """Decoder keeping the history pages and the data records it decodes."""
+
+    def __init__(self):
+        super().__init__()
+        self.history = []
+        self.records = {}
+        self.max_data = 0
+
+    def record(self, kind, value):
+        if kind == decode_uplink.HISTORY:
+            self.history.append(bytes(value))
+        if kind == decode_uplink.DATA:
+            self.records[bytes(value[:4])] = bytes(value)
+        return super().record(kind, value)
+
+    def frame(self, payload):
+        lines = super().frame(payload)
+        self.max_data = max(self.max_data, len(self.data))
+        return lines
+
+
+def run_simulator(path):
+    result = subprocess.run([path] + SIMULATOR_ARGS, stdout=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        sys.exit("%s failed with status %d" % (path, result.returncode))
+    frames = []
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[0] == "UPLINK" and fields[1] == "4":
+            frames.append(bytes.fromhex(fields[2]))
+    return frames
+
+
+def records(frames, kind):
+    """Yields the index of the frame and the value of each record of a type."""
+    for i, frame in enumerate(frames):
+        j = 0
+        while j + 2 <= len(frame):
+            if frame[j] == kind:
+                yield i, frame[j + 2:j + 2 + frame[j + 1]]
+            j += 2 + frame[j + 1]
+
+
+def fragment_sessions(frames):
+    """Frames holding a fragment, by session."""
+    sessions = {}
+    for i, value in records(frames, decode_uplink.FRAGMENT):
+        sessions.setdefault(value[0], set()).add(i)
+    return sessions
+
+
+def decode(frames, decoder=None):
+    decoder = decoder or RecordingDecoder()
+    for frame in frames:
+        decoder.frame(frame)
+    return decoder
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Round trip of the uplinks through tools/decode_uplink.py.")
+    parser.add_argument("--simulator", default=os.path.join(os.environ.get("BUILD_DIR", "/tmp/tp_host_build"), "boot_sim_edge"))
+    parser.add_argument("--trials", type=int, default=200)
+    parser.add_argument("--loss", type=float, default=0.2, help="probability of losing each frame")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    frames = run_simulator(args.simulator)
+    sessions = fragment_sessions(frames)
+    lossless = decode(frames)
+    reference = lossless.history
+    failures = []
+    if not sessions or len(reference) != len(sessions):
+        failures.append("%d fragment sessions sent, %d pages reassembled without loss" % (len(sessions), len(reference)))
+    data_frames = dict((bytes(value[:4]), i) for i, value in records(frames, decode_uplink.DATA))
+
+    # Sessions decoded again after a reset of the node
+    if decode(frames, decode(frames)).history != reference + reference:
+        failures.append("the sessions are not reassembled again after a reset")
+
+    generator = random.Random(args.seed)
+    recovered = 0
+    rebuilt = 0
+    for _ in range(args.trials):
+        kept = set(i for i in range(len(frames)) if generator.random() >= args.loss)
+        decoder = decode([frames[i] for i in sorted(kept)])
+        wrong = [page for page in decoder.history if page not in reference]
+        if wrong:
+            failures.append("page reassembled wrongly: %s" % wrong[0].hex())
+        # Every session received in full is reassembled, the others need the parity fragments
+        complete = sum(1 for indexes in sessions.values() if indexes.issubset(kept))
+        recovered += len(decoder.history) - complete
+
+        for sequence, record in decoder.records.items():
+            if lossless.records.get(sequence) != record:
+                failures.append("data record rebuilt wrongly: %s" % record.hex())
+            elif data_frames[sequence] not in kept:
+                rebuilt += 1
+        if decoder.max_data > PARITY_DEPTH + 1:
+            failures.append("%d data records kept by the decoder" % decoder.max_data)
+    if recovered == 0:
+        failures.append("no page recovered from its parity fragments")
+    if rebuilt == 0:
+        failures.append("no data record rebuilt from a parity record")
+
+    print("%d frames, %d fragment sessions, %d data records, %d trials at %.0f %% loss:"
+          % (len(frames), len(sessions), len(data_frames), args.trials, 100 * args.loss))
+    print("%d pages recovered from lost fragments, %d lost data records rebuilt" % (recovered, rebuilt))
+    for failure in failures[:10]:
+        print("FAIL: " + failure)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
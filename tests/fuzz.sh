@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# File: fuzz.sh
+#
+# Description:
+# Builds and runs the fuzz target of the credentials console
+# (fuzz_credentials.cpp) against the firmware compiled for the simulated
+# board of tests/host, with AddressSanitizer and UndefinedBehaviorSanitizer.
+# With clang, the target is built with -fsanitize=fuzzer and run by
+# libFuzzer for $FUZZ_SECONDS seconds (default 60) on the corpus directory
+# $BUILD_DIR/fuzz_corpus. Without clang, it is built with g++ and its
+# standalone driver runs $FUZZ_RUNS random inputs (default 100000).
+#
+# Usage: tests/fuzz.sh [options of the fuzzer]
+# The program is written to $BUILD_DIR (default /tmp/tp_host_build).
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=${BUILD_DIR:-/tmp/tp_host_build}
+FLAGS="-std=gnu++11 -O1 -g -Wall -Wno-unused-parameter -fno-sanitize-recover=undefined"
+
+mkdir -p "$BUILD_DIR"
+
+# Firmware sources, the sketch being C++
+FIRMWARE="-x c++ $ROOT/TP/TP.ino -x none $(ls "$ROOT"/TP/*.cpp)"
+INCLUDES="-I$ROOT/tests/host -I$ROOT/TP"
+SOURCES="$FIRMWARE $ROOT/tests/host/Simulator.cpp $ROOT/tests/fuzz_credentials.cpp"
+
+if command -v clang++ > /dev/null 2>&1; then
+  clang++ $FLAGS -fsanitize=fuzzer,address,undefined $INCLUDES -o "$BUILD_DIR/fuzz_credentials" $SOURCES
+  mkdir -p "$BUILD_DIR/fuzz_corpus"
+  "$BUILD_DIR/fuzz_credentials" -max_total_time="${FUZZ_SECONDS:-60}" -max_len=256 "$@" "$BUILD_DIR/fuzz_corpus"
+else
+  echo "clang++ not found, building the standalone driver with ${CXX:-g++}"
+  ${CXX:-g++} $FLAGS -fsanitize=address,undefined -DFUZZ_STANDALONE $INCLUDES -o "$BUILD_DIR/fuzz_credentials" $SOURCES
+  "$BUILD_DIR/fuzz_credentials" --runs "${FUZZ_RUNS:-100000}" "$@"
+fi
@@ -0,0 +1,188 @@
+/*
+ * File: fuzz_credentials.cpp
+ *
+ * Description:
+ * Fuzz target of the credentials console: each input is received on the
+ * USB console of the simulated board (tests/host) and processed by
+ * readCommands(), that is Console::readLine() and processCommand() as in
+ * init_Credentials(). The sanitizers catch the memory errors, and the
+ * target checks that the configuration is only finished with valid
+ * credentials: configuration implies isDevEUI(), isAppEUI() and isAppKey().
+ *
+ * Built by tests/fuzz.sh, as a libFuzzer target with clang, or with g++
+ * and the standalone driver of this file (FUZZ_STANDALONE), which runs the
+ * inputs given as files, or random inputs built from the tokens of the
+ * command set.
+ *
+ * Usage: fuzz_credentials [libFuzzer options] [corpus directory]
+ *        fuzz_credentials (standalone) [--runs N] [--seed N] [file ...]
+ */
+
+#include <random>
+#include <string>
+
+#include <Arduino.h>
+#include "Simulator.hpp"
+#include "Driver_Credentials.hpp"
+#include "Crc.hpp"
+
+// Configurations finished by the inputs, reported by the standalone driver
+static unsigned long configurations = 0;
+
+/**
+ * @brief Processes one input on a console left as after the reset.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  sim::parameters.echo = false;
+  sim::parameters.limitS = 1e12;
+  configuration = false;
+  devEui[0] = '\0';
+  appEui[0] = '\0';
+  appKey[0] = '\0';
+
+  // The input ends with a line terminator, so that no partial line is left
+  // to the next input
+  sim::hostWrite(data, size);
+  sim::hostWrite((const uint8_t *)"\n", 1);
+  sim::advance(4 * sim::parameters.usbLatencyUs);
+  while (Serial.available() > 0)
+  {
+    readCommands();
+    if (configuration && !(isDevEUI(devEui) && isAppEUI(appEui) && isAppKey(appKey)))
+    {
+      fprintf(stderr, "configuration finished with invalid credentials: devEUI \"%s\" appEUI \"%s\" appKey \"%s\"\n",
+        devEui, appEui, appKey);
+      abort();
+    }
+    // After the configuration, the rest of the input is processed as a new boot would
+    configurations += configuration;
+    configuration = false;
+  }
+  updateConsole();
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+// Tokens of the random inputs: commands, credentials, separators and control characters
+static const char *const tokens[] =
+{
+  "AT?", "AT+D=", "AT+A=", "AT+K=", "AT+S", "AT+P=", "AT+", "AT",
+  "0011223344556677", "70B3D57ED0000000", "000102030405060708090A0B0C0D0E0F",
+  "0123", "ABCDEF", "abcdef", "G", ",", "=", " ", "\r", "\n", "\r\n", "\t", "\x7F", "\xFF"
+};
+static const size_t TOKEN_COUNT = sizeof(tokens) / sizeof(tokens[0]);
+
+// Commands taking a value, and the valid values of the random inputs
+static const char *const setCommands[] = { "AT+D=", "AT+A=", "AT+K=" };
+static const char *const values[] = { "0011223344556677", "70B3D57ED0000000", "000102030405060708090A0B0C0D0E0F" };
+static const char *const terminators[] = { "\r", "\n", "\r\n" };
+
+/**
+ * @brief Returns a valid AT+P message.
+ */
+static std::string provisioningMessage()
+{
+  const char body[] = "0011223344556677,70B3D57ED0000000,000102030405060708090A0B0C0D0E0F";
+  char message[sizeof(body) + 16];
+  snprintf(message, sizeof(message), "AT+P=%s,%04X", body, crc16Ccitt((const uint8_t *)body, strlen(body)));
+  return message;
+}
+
+/**
+ * @brief Changes a few random bytes of a line, or none.
+ */
+static void mutate(std::string &line, std::mt19937 &generator)
+{
+  for (unsigned int n = generator() % 4 == 0 ? generator() % 3 + 1 : 0; n > 0 && !line.empty(); n--)
+  {
+    line[generator() % line.size()] = generator() % 256;
+  }
+}
+
+/**
+ * @brief Builds a random input of a few lines: commands with valid or wrong
+ * values, AT+S and AT+P messages, or random tokens and bytes, each line
+ * possibly mutated.
+ */
+static std::string randomInput(std::mt19937 &generator)
+{
+  std::string input;
+  for (unsigned int lines = generator() % 6 + 1; lines > 0; lines--)
+  {
+    std::string line;
+    switch (generator() % 4)
+    {
+      case 0:
+        line = std::string(setCommands[generator() % 3]) + values[generator() % 3];
+        break;
+      case 1:
+        line = "AT+S";
+        break;
+      case 2:
+        line = provisioningMessage();
+        break;
+      default:
+        for (unsigned int n = generator() % 8; n > 0; n--)
+        {
+          line += generator() % 8 == 0 ? std::string(1, (char)(generator() % 256)) : tokens[generator() % TOKEN_COUNT];
+        }
+        break;
+    }
+    mutate(line, generator);
+    input += line + terminators[generator() % 3];
+  }
+  return input;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned long runs = 100000;
+  std::mt19937 generator(1);
+  int files = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    if (option == "--runs" && i + 1 < argc)
+    {
+      runs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (option == "--seed" && i + 1 < argc)
+    {
+      generator.seed(strtoul(argv[++i], NULL, 10));
+    }
+    else
+    {
+      FILE *file = fopen(argv[i], "rb");
+      if (file == NULL)
+      {
+        perror(argv[i]);
+        return 2;
+      }
+      std::string input;
+      int c;
+      while ((c = fgetc(file)) != EOF)
+      {
+        input += (char)c;
+      }
+      fclose(file);
+      LLVMFuzzerTestOneInput((const uint8_t *)input.data(), input.size());
+      files++;
+    }
+  }
+
+  if (files == 0)
+  {
+    for (unsigned long run = 0; run < runs; run++)
+    {
+      std::string input = randomInput(generator);
+      LLVMFuzzerTestOneInput((const uint8_t *)input.data(), input.size());
+    }
+    printf("%lu random inputs processed, %lu configurations finished\n", runs, configurations);
+  }
+  return 0;
+}
+
+#endif
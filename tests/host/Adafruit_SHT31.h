@@ -0,0 +1,22 @@
+/*
+ * File: Adafruit_SHT31.h
+ *
+ * Description:
+ * Host replacement of the Adafruit SHT31 library, limited to begin(): the
+ * firmware reads the sensor through Wire.
+ */
+
+#ifndef HPP__HOST_ADAFRUIT_SHT31__HPP
+#define HPP__HOST_ADAFRUIT_SHT31__HPP
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_SHT31
+{
+public:
+  Adafruit_SHT31(TwoWire *wire = &Wire) {}
+  bool begin(uint8_t address = 0x44);
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * File: Arduino.h
+ *
+ * Description:
+ * Host replacement of the Arduino SAMD core, used to build the firmware of
+ * the node on a PC (see tests/build.sh). Only the subset used by the
+ * firmware is provided. Time is simulated: delay() and delayMicroseconds()
+ * advance the clock, and every call to millis() or micros() advances it by
+ * a few microseconds, so that the busy loops of the firmware end. The
+ * serial ports deliver their bytes at the time they would arrive on the
+ * board, see Simulator.hpp.
+ *
+ * Note:
+ * As in the SAMD core, min(), max() and constrain() are macros: the C++
+ * standard headers must be included before this file.
+ */
+
+#ifndef HPP__HOST_ARDUINO__HPP
+#define HPP__HOST_ARDUINO__HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+
+#define PIN_WIRE_SDA 11
+#define PIN_WIRE_SCL 12
+#define LORA_RESET 31
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *text) { return text == NULL ? 0 : write((const uint8_t *)text, strlen(text)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char text[]) { return write(text); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// Serial port of the board. The received bytes are queued with their arrival
+// time, and the sent bytes take the time of their transmission at the baud rate.
+class HardwareSerial : public Stream
+{
+public:
+  explicit HardwareSerial(const char *name);
+  void begin(unsigned long baudrate);
+  void end() {}
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int availableForWrite() override;
+  explicit operator bool();
+
+  const char *name;
+  unsigned long baudrate;
+};
+
+// USB CDC port of the SAMD21, used for the console
+class Serial_ : public HardwareSerial
+{
+public:
+  Serial_() : HardwareSerial("Serial") {}
+};
+
+extern Serial_ Serial;
+extern HardwareSerial SerialLoRa;
+
+// SAMD21 NVMCTRL subset: the commands complete at once, and the flash is
+// written directly (see Simulator.cpp)
+struct NvmCtrlCtrlA { uint16_t reg; };
+struct NvmCtrlCtrlB { struct { uint32_t MANW:1; uint32_t RWS:4; uint32_t CACHEDIS:2; } bit; uint32_t reg; };
+struct NvmCtrlIntFlag { struct { uint8_t READY:1; uint8_t ERROR:1; } bit; uint8_t reg; };
+struct NvmCtrlStatus { uint16_t reg; };
+struct NvmCtrlAddr { uint32_t reg; };
+struct Nvmctrl { NvmCtrlCtrlA CTRLA; NvmCtrlCtrlB CTRLB; NvmCtrlIntFlag INTFLAG; NvmCtrlStatus STATUS; NvmCtrlAddr ADDR; };
+extern volatile Nvmctrl *NVMCTRL;
+#define NVMCTRL_CTRLA_CMDEX_KEY 0xA500
+#define NVMCTRL_CTRLA_CMD_ER 0x02
+#define NVMCTRL_CTRLA_CMD_WP 0x04
+#define NVMCTRL_CTRLA_CMD_PBC 0x44
+#define NVMCTRL_CTRLA_CMD_LR 0x40
+#define NVMCTRL_STATUS_MASK 0x1E
+#define FLASH_PAGE_SIZE 64
+#define FLASH_SIZE 0x40000UL
+
+// SAMD21 PORT subset and pin table of the variant: the host pins are not simulated
+struct PortOutclr { uint32_t reg; };
+struct PortGroup { PortOutclr OUTCLR; };
+struct Port { PortGroup Group[2]; };
+extern volatile Port *PORT;
+struct PinDescription { uint8_t ulPort; uint32_t ulPin; };
+extern const PinDescription g_APinDescription[];
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#endif
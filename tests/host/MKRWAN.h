@@ -0,0 +1,36 @@
+/*
+ * File: MKRWAN.h
+ *
+ * Description:
+ * Host replacement of the MKRWAN library: the LoRaModem methods used by
+ * the firmware, answered by the simulated modem of Simulator.cpp with the
+ * durations of a Murata module (begin, join, confirmed uplink).
+ */
+
+#ifndef HPP__HOST_MKRWAN__HPP
+#define HPP__HOST_MKRWAN__HPP
+
+#include <Arduino.h>
+
+typedef enum { AS923 = 0, AU915, CN470, CN779, EU433, EU868, KR920, IN865, US915 } _lora_band;
+typedef enum { CLASS_A = 'A', CLASS_B, CLASS_C } _lora_class;
+
+class LoRaModem : public Stream
+{
+public:
+  int begin(_lora_band band, uint32_t baudrate = 19200, uint16_t timeout = 2000);
+  int joinOTAA(const char *appEui, const char *appKey, const char *devEui = NULL, uint32_t timeout = 60000);
+  bool minPollInterval(unsigned long seconds) { return true; }
+  bool dataRate(uint8_t rate) { return true; }
+  bool setPort(uint8_t port);
+  bool configureClass(_lora_class deviceClass) { return true; }
+  int beginPacket();
+  int endPacket(bool confirmed = false);
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+};
+
+#endif
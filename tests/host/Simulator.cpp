@@ -0,0 +1,662 @@
+/*
+ * File: Simulator.cpp
+ *
+ * Description:
+ * This source file implements the simulated board of Simulator.hpp, and
+ * the host versions of the Arduino core, Wire, Adafruit_SHT31 and MKRWAN
+ * functions used by the firmware.
+ *
+ * The bytes sent on a serial port are transmitted one after the other at
+ * the baud rate of the port (10 bits per byte), the firmware only waiting
+ * when the 64-byte transmit buffer of the UART is full. The modem handles
+ * one command at a time: its reply starts after the end of the command,
+ * the end of the previous reply and its processing time.
+ *
+ * The constant data of the program stand for the flash of the SAMD21: they
+ * are made writable at startup, so that the pages the firmware writes with
+ * the NVM controller (see TP/History.cpp) are written.
+ */
+
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <deque>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SHT31.h>
+#include <MKRWAN.h>
+#include "Simulator.hpp"
+
+#define UART_TX_BUFFER_SIZE 64
+#define SHT31_CRC_INIT 0xFF
+#define SHT31_CRC_POLYNOMIAL 0x31
+
+namespace sim
+{
+
+Parameters parameters;
+uint64_t now = 0;
+uint8_t modemNvm[256];
+void (*consoleLine)(const char *line) = NULL;
+void (*uplinkSent)(uint8_t port, const uint8_t data[], size_t length) = NULL;
+
+// Bytes received by a serial port, with their arrival time
+typedef std::deque<std::pair<uint64_t, uint8_t> > ReceiveQueue;
+
+// The NVM of a new modem is erased
+static struct ModemNvmErase
+{
+  ModemNvmErase() { memset(modemNvm, 0xFF, sizeof(modemNvm)); }
+} modemNvmErase;
+
+static std::mt19937 &generator()
+{
+  static std::mt19937 instance(parameters.seed);
+  return instance;
+}
+
+// State of the console host
+static ReceiveQueue consoleInput;
+static std::string consoleOutput;
+
+// State of the modem and of its UART
+static ReceiveQueue modemOutput;
+static std::string modemCommand;
+static uint64_t modemUartFree = 0;
+static uint64_t modemBusyUntil = 0;
+static bool modemAsleep = false;
+static uint16_t channelMask = 0x0007;
+static uint8_t uplinkPort = 0;
+static std::vector<uint8_t> uplinkPayload;
+static std::deque<std::vector<uint8_t> > downlinks;
+static std::vector<uint8_t> downlink;
+static size_t downlinkIndex = 0;
+
+/**
+ * @brief Advances the simulated clock.
+ *
+ * @param us The duration in microseconds.
+ */
+void advance(uint64_t us)
+{
+  now += us;
+  if (now > (uint64_t)(parameters.limitS * 1e6))
+  {
+    // The firmware may wait forever, e.g. for its credentials
+    fflush(stdout);
+    fprintf(stderr, "simulated time limit reached\n");
+    exit(1);
+  }
+}
+
+/**
+ * @brief Applies the jitter to a duration.
+ *
+ * @param us The nominal duration in microseconds.
+ *
+ * @return The duration varied randomly by +/- parameters.jitter.
+ */
+uint64_t vary(uint64_t us)
+{
+  std::uniform_real_distribution<double> factor(1 - parameters.jitter, 1 + parameters.jitter);
+  return (uint64_t)(us * factor(generator()));
+}
+
+/**
+ * @brief Draws an event of the given probability.
+ */
+bool chance(double probability)
+{
+  std::uniform_real_distribution<double> draw(0, 1);
+  return draw(generator()) < probability;
+}
+
+/**
+ * @brief Time taken by a byte on a serial line, 8N1.
+ */
+static uint64_t byteTime(unsigned long baudrate)
+{
+  return 10000000ULL / (baudrate > 0 ? baudrate : 9600);
+}
+
+/**
+ * @brief Sends a line from the console host to the firmware.
+ *
+ * The line is terminated by CR LF and arrives after the USB latency.
+ *
+ * @param line The line to send.
+ */
+void hostSend(const char *line)
+{
+  std::string text = std::string(line) + "\r\n";
+  hostWrite((const uint8_t *)text.data(), text.size());
+}
+
+/**
+ * @brief Sends raw bytes from the console host, received in one USB transfer.
+ */
+void hostWrite(const uint8_t data[], size_t length)
+{
+  uint64_t arrival = now + vary(parameters.usbLatencyUs);
+  if (!consoleInput.empty() && consoleInput.back().first > arrival)
+  {
+    arrival = consoleInput.back().first;
+  }
+  for (size_t i = 0; i < length; i++)
+  {
+    consoleInput.push_back(std::make_pair(arrival, data[i]));
+  }
+}
+
+/**
+ * @brief Queues a downlink, received by the modem with the next acknowledged uplink.
+ */
+void queueDownlink(const uint8_t data[], size_t length)
+{
+  downlinks.push_back(std::vector<uint8_t>(data, data + length));
+}
+
+/**
+ * @brief Prints a line of the firmware console and passes it to the scenario.
+ */
+static void consoleWrite(uint8_t c)
+{
+  if (c == '\r')
+  {
+    return;
+  }
+  if (c != '\n')
+  {
+    consoleOutput += (char)c;
+    return;
+  }
+  if (parameters.echo)
+  {
+    printf("%s\n", consoleOutput.c_str());
+  }
+  if (consoleLine != NULL)
+  {
+    consoleLine(consoleOutput.c_str());
+  }
+  consoleOutput.clear();
+}
+
+/**
+ * @brief Queues the reply of the modem to a command fully received at the given time.
+ */
+static void modemReply(const char *reply, uint64_t received, uint64_t processingUs)
+{
+  uint64_t start = (received > modemBusyUntil ? received : modemBusyUntil) + vary(processingUs);
+  std::string text = std::string(reply) + "\r\n";
+  uint64_t byte = byteTime(SerialLoRa.baudrate);
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    modemOutput.push_back(std::make_pair(start + (i + 1) * byte, (uint8_t)text[i]));
+  }
+  modemBusyUntil = start + text.size() * byte;
+}
+
+/**
+ * @brief Executes an AT command received by the modem.
+ *
+ * A command received while the modem sleeps only wakes it up. A fraction
+ * parameters.dropRate of the commands is not answered.
+ */
+static void modemExecute(const std::string &command, uint64_t received)
+{
+  if (modemAsleep)
+  {
+    modemAsleep = false;
+    modemBusyUntil = received + vary(parameters.wakeMs * 1000);
+    return;
+  }
+  if (parameters.traceModem)
+  {
+    fprintf(stderr, "%10.3f modem < %s\n", received / 1e6, command.c_str());
+  }
+  if (command.empty() || command == "AT$APKACCESS" || chance(parameters.dropRate))
+  {
+    return;
+  }
+
+  char reply[32] = "+OK";
+  uint64_t processing = parameters.commandMs * 1000;
+  if (command.compare(0, 7, "AT$NVM ") == 0)
+  {
+    unsigned address = 0;
+    unsigned value = 0;
+    if (sscanf(command.c_str() + 7, "%u,%u", &address, &value) == 2 && address < 256 && value < 256)
+    {
+      modemNvm[address] = value;
+      processing = parameters.nvmWriteMs * 1000;
+    }
+    else if (address < 256)
+    {
+      snprintf(reply, sizeof(reply), "+OK=%u", modemNvm[address]);
+      processing = parameters.nvmReadMs * 1000;
+    }
+    else
+    {
+      strcpy(reply, "+ERR");
+    }
+  }
+  else if (command == "AT$LINKCHECK?")
+  {
+    strcpy(reply, "+OK=20,1");
+  }
+  else if (command == "AT+CHANMASK?")
+  {
+    snprintf(reply, sizeof(reply), "+OK=%04x%020d", channelMask, 0);
+  }
+  else if (command.compare(0, 12, "AT+CHANMASK=") == 0)
+  {
+    // Channels undefined in the plan of the network are rejected
+    uint16_t mask = (uint16_t)strtoul(command.substr(12, 4).c_str(), NULL, 16);
+    if (mask == 0 || (mask & ~parameters.channelPlan) != 0)
+    {
+      strcpy(reply, "+ERR");
+    }
+    else
+    {
+      channelMask = mask;
+    }
+  }
+  else if (command == "AT$SLEEP")
+  {
+    modemReply(reply, received, processing);
+    modemAsleep = true;
+    return;
+  }
+  modemReply(reply, received, processing);
+}
+
+/**
+ * @brief Receives a byte sent by the firmware to the modem.
+ */
+static void modemWrite(uint8_t c)
+{
+  uint64_t byte = byteTime(SerialLoRa.baudrate);
+  modemUartFree = (modemUartFree > now ? modemUartFree : now) + byte;
+  if (modemUartFree > now + UART_TX_BUFFER_SIZE * byte)
+  {
+    advance(modemUartFree - UART_TX_BUFFER_SIZE * byte - now);
+  }
+
+  if (c == '\n')
+  {
+    modemExecute(modemCommand, modemUartFree);
+    modemCommand.clear();
+  }
+  else if (c != '\r')
+  {
+    modemCommand += (char)c;
+  }
+}
+
+/**
+ * @brief Restarts the simulated modem, as done by modem.begin().
+ */
+static bool modemBegin()
+{
+  advance(vary(parameters.modemBeginMs * 1000));
+  modemOutput.clear();
+  modemCommand.clear();
+  modemBusyUntil = now;
+  modemAsleep = false;
+  channelMask = 0x0007;
+  return chance(parameters.modemBeginSuccess);
+}
+
+static ReceiveQueue &receiveQueue(const HardwareSerial *port)
+{
+  return port == &Serial ? consoleInput : modemOutput;
+}
+
+/**
+ * @brief Simulated SHT31: the measurement in raw words with their CRC.
+ */
+static uint8_t sht31Crc(uint8_t msb, uint8_t lsb)
+{
+  uint8_t crc = SHT31_CRC_INIT;
+  uint8_t data[2] = { msb, lsb };
+  for (int i = 0; i < 2; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = crc & 0x80 ? (crc << 1) ^ SHT31_CRC_POLYNOMIAL : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void sht31Measurement(uint8_t data[6])
+{
+  if (parameters.sensorWalk > 0)
+  {
+    int walk = parameters.sensorWalk;
+    parameters.temperature = constrain(parameters.temperature + (int)(generator()() % (2 * walk + 1)) - walk, -4000, 12000);
+    parameters.humidity = constrain(parameters.humidity + (int)(generator()() % (2 * walk + 1)) - walk, 0, 10000);
+  }
+  uint16_t words[2] =
+  {
+    (uint16_t)((parameters.temperature + 4500) * 65535L / 17500),
+    (uint16_t)(parameters.humidity * 65535L / 10000)
+  };
+  for (int i = 0; i < 2; i++)
+  {
+    data[3 * i] = words[i] >> 8;
+    data[3 * i + 1] = words[i] & 0xFF;
+    data[3 * i + 2] = sht31Crc(data[3 * i], data[3 * i + 1]);
+  }
+}
+
+}
+
+using namespace sim;
+
+// Arduino core
+
+Serial_ Serial;
+HardwareSerial SerialLoRa("SerialLoRa");
+TwoWire Wire;
+static Nvmctrl nvmctrl = { {0}, {{0, 0, 0}}, {{1, 0}}, {0}, {0} };
+volatile Nvmctrl *NVMCTRL = &nvmctrl;
+static Port port;
+volatile Port *PORT = &port;
+const PinDescription g_APinDescription[LORA_RESET + 1] = {};
+
+/**
+ * @brief Makes the read-only data segments of the program writable.
+ *
+ * Only the first object listed, the program itself, is changed.
+ */
+static int unprotectFlash(struct dl_phdr_info *info, size_t size, void *data)
+{
+  uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  for (int i = 0; i < info->dlpi_phnum; i++)
+  {
+    const ElfW(Phdr) &segment = info->dlpi_phdr[i];
+    if (segment.p_type == PT_LOAD && !(segment.p_flags & (PF_W | PF_X)))
+    {
+      uintptr_t start = (info->dlpi_addr + segment.p_vaddr) & ~(pageSize - 1);
+      uintptr_t end = info->dlpi_addr + segment.p_vaddr + segment.p_memsz;
+      mprotect((void *)start, end - start, PROT_READ | PROT_WRITE);
+    }
+  }
+  return 1;
+}
+
+__attribute__((constructor))
+static void initFlash()
+{
+  dl_iterate_phdr(unprotectFlash, NULL);
+}
+
+unsigned long millis()
+{
+  advance(parameters.pollCostUs);
+  return (unsigned long)(now / 1000);
+}
+
+unsigned long micros()
+{
+  advance(parameters.pollCostUs);
+  return (unsigned long)now;
+}
+
+void delay(unsigned long ms)
+{
+  advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+
+int digitalRead(uint8_t pin)
+{
+  return HIGH;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size-- > 0)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base)
+{
+  if (value < 0 && base == DEC)
+  {
+    return print('-') + print((unsigned long)-value, base);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  char text[8 * sizeof(long) + 1];
+  char *p = &text[sizeof(text) - 1];
+  *p = '\0';
+  do
+  {
+    unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return write(p);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+HardwareSerial::HardwareSerial(const char *name) : name(name), baudrate(0) {}
+
+void HardwareSerial::begin(unsigned long rate)
+{
+  baudrate = rate;
+}
+
+int HardwareSerial::available()
+{
+  int count = 0;
+  ReceiveQueue &queue = receiveQueue(this);
+  for (ReceiveQueue::const_iterator i = queue.begin(); i != queue.end() && i->first <= now; ++i)
+  {
+    count++;
+  }
+  return count;
+}
+
+int HardwareSerial::read()
+{
+  ReceiveQueue &queue = receiveQueue(this);
+  if (queue.empty() || queue.front().first > now)
+  {
+    return -1;
+  }
+  uint8_t c = queue.front().second;
+  queue.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek()
+{
+  ReceiveQueue &queue = receiveQueue(this);
+  return queue.empty() || queue.front().first > now ? -1 : queue.front().second;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (this == &Serial)
+  {
+    consoleWrite(c);
+  }
+  else
+  {
+    modemWrite(c);
+  }
+  return 1;
+}
+
+int HardwareSerial::availableForWrite()
+{
+  return this == &Serial ? 256 : UART_TX_BUFFER_SIZE;
+}
+
+HardwareSerial::operator bool()
+{
+  return this != &Serial || parameters.consoleConnected;
+}
+
+// Wire and SHT31
+
+void TwoWire::beginTransmission(uint8_t addressValue)
+{
+  address = addressValue;
+  txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+  // The SHT31 acknowledges its address and the general call, NACK otherwise
+  return address == 0x44 || address == 0 ? 0 : 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addressValue, size_t count, bool stop)
+{
+  rxLength = rxIndex = 0;
+  if (addressValue != 0x44 || count > sizeof(rx))
+  {
+    return 0;
+  }
+  uint8_t measurement[6];
+  sht31Measurement(measurement);
+  for (size_t i = 0; i < count; i++)
+  {
+    rx[i] = measurement[i % sizeof(measurement)];
+  }
+  rxLength = count;
+  return count;
+}
+
+size_t TwoWire::write(uint8_t c)
+{
+  if (txLength < sizeof(tx))
+  {
+    tx[txLength++] = c;
+  }
+  return 1;
+}
+
+int TwoWire::available()
+{
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read()
+{
+  return rxIndex < rxLength ? rx[rxIndex++] : -1;
+}
+
+int TwoWire::peek()
+{
+  return rxIndex < rxLength ? rx[rxIndex] : -1;
+}
+
+bool Adafruit_SHT31::begin(uint8_t address)
+{
+  // Soft reset of the sensor
+  advance(vary(1000));
+  return address == 0x44;
+}
+
+// MKRWAN
+
+int LoRaModem::begin(_lora_band band, uint32_t baudrate, uint16_t timeout)
+{
+  return modemBegin();
+}
+
+int LoRaModem::joinOTAA(const char *appEui, const char *appKey, const char *devEui, uint32_t timeout)
+{
+  advance(vary(parameters.joinMs * 1000));
+  if (!chance(parameters.joinSuccess))
+  {
+    return 0;
+  }
+  channelMask = parameters.channelPlan;
+  return 1;
+}
+
+bool LoRaModem::setPort(uint8_t port)
+{
+  uplinkPort = port;
+  return true;
+}
+
+int LoRaModem::beginPacket()
+{
+  uplinkPayload.clear();
+  return 1;
+}
+
+size_t LoRaModem::write(uint8_t c)
+{
+  uplinkPayload.push_back(c);
+  return 1;
+}
+
+int LoRaModem::endPacket(bool confirmed)
+{
+  advance(vary(parameters.uplinkMs * 1000));
+  if (!chance(parameters.uplinkSuccess))
+  {
+    return -1;
+  }
+  if (uplinkSent != NULL)
+  {
+    uplinkSent(uplinkPort, uplinkPayload.data(), uplinkPayload.size());
+  }
+  if (downlinkIndex >= downlink.size() && !downlinks.empty())
+  {
+    downlink = downlinks.front();
+    downlinks.pop_front();
+    downlinkIndex = 0;
+  }
+  return (int)uplinkPayload.size();
+}
+
+int LoRaModem::available()
+{
+  return (int)(downlink.size() - downlinkIndex);
+}
+
+int LoRaModem::read()
+{
+  return downlinkIndex < downlink.size() ? downlink[downlinkIndex++] : -1;
+}
+
+int LoRaModem::peek()
+{
+  return downlinkIndex < downlink.size() ? downlink[downlinkIndex] : -1;
+}
@@ -0,0 +1,86 @@
+/*
+ * File: Simulator.hpp
+ *
+ * Description:
+ * Simulated board on which the firmware of the node runs on a PC. It holds
+ * the simulated clock, the devices around the SAMD21 and their timing:
+ * - the console host on the USB port (Serial), sending lines with the USB
+ *   latency and receiving the lines printed by the firmware,
+ * - the LoRa modem on its UART (SerialLoRa) at the baud rate set by the
+ *   firmware: AT commands, NVM, sleep, and the LoRaModem methods of the
+ *   MKRWAN library (begin, join, uplinks, downlinks),
+ * - the SHT31 on the I2C bus.
+ *
+ * The durations are the model of the board: they are parameters, so that
+ * they can be calibrated against the profiles measured on a board (see
+ * tools/boot_benchmark.py). Each duration varies randomly by +/- jitter.
+ *
+ * Functions:
+ * - advance: Advances the simulated clock.
+ * - vary: Applies the jitter to a duration.
+ * - chance: Draws an event of the given probability.
+ * - hostSend: Sends a line from the console host to the firmware.
+ * - hostWrite: Sends raw bytes from the console host to the firmware.
+ * - queueDownlink: Queues a downlink, received with the next uplink.
+ */
+
+#ifndef HPP__SIMULATOR__HPP
+#define HPP__SIMULATOR__HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sim
+{
+
+struct Parameters
+{
+  uint32_t seed = 1;
+  double limitS = 600;                // simulated time after which the program exits
+  double jitter = 0.25;               // relative variation of the durations
+  unsigned long pollCostUs = 1;       // time taken by each millis() or micros() call
+  unsigned long usbLatencyUs = 1000;  // transfer of a line on the USB console
+  bool consoleConnected = true;       // a host has opened the USB console
+  bool echo = true;                   // print the console of the firmware on stdout
+  bool traceModem = false;            // print the AT commands received by the modem on stderr
+  unsigned long modemBeginMs = 600;   // reset pulse and band configuration of modem.begin()
+  double modemBeginSuccess = 1.0;
+  unsigned long commandMs = 1;        // processing of an AT command by the modem
+  unsigned long nvmReadMs = 2;
+  unsigned long nvmWriteMs = 10;
+  unsigned long wakeMs = 5;           // wake up of the modem from its sleep mode
+  double dropRate = 0.0;              // AT commands left unanswered by the modem
+  unsigned long joinMs = 5200;        // join request and join accept in RX1
+  double joinSuccess = 1.0;
+  uint16_t channelPlan = 0x00FF;      // channels enabled by the join: 3 default, 5 of the CFList
+  unsigned long uplinkMs = 1200;      // confirmed uplink, up to the acknowledgement
+  double uplinkSuccess = 1.0;
+  int16_t temperature = 2150;         // SHT31 readings in hundredths
+  int16_t humidity = 5000;
+  int16_t sensorWalk = 0;             // maximum change of the readings between two measurements, in hundredths
+};
+
+extern Parameters parameters;
+
+// Simulated time since the reset, in microseconds
+extern uint64_t now;
+
+// NVM of the modem, read and written with AT$NVM
+extern uint8_t modemNvm[256];
+
+// Called with each line printed by the firmware on the console
+extern void (*consoleLine)(const char *line);
+
+// Called with each uplink acknowledged by the network
+extern void (*uplinkSent)(uint8_t port, const uint8_t data[], size_t length);
+
+void advance(uint64_t us);
+uint64_t vary(uint64_t us);
+bool chance(double probability);
+void hostSend(const char *line);
+void hostWrite(const uint8_t data[], size_t length);
+void queueDownlink(const uint8_t data[], size_t length);
+
+}
+
+#endif
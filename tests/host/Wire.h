@@ -0,0 +1,40 @@
+/*
+ * File: Wire.h
+ *
+ * Description:
+ * Host replacement of the Wire library: the I2C bus of the simulated board,
+ * on which the SHT31 of Simulator.cpp answers.
+ */
+
+#ifndef HPP__HOST_WIRE__HPP
+#define HPP__HOST_WIRE__HPP
+
+#include <Arduino.h>
+
+class TwoWire : public Stream
+{
+public:
+  void begin() {}
+  void end() {}
+  void setClock(uint32_t) {}
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t address, size_t count, bool stop = true);
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+private:
+  uint8_t address = 0;
+  uint8_t tx[8];
+  uint8_t txLength = 0;
+  uint8_t rx[8];
+  uint8_t rxLength = 0;
+  uint8_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+#
+# File: boot_benchmark.py
+#
+# Description:
+# Aggregates the boot profiles reported by the node (see TP/Profiler.cpp)
+# over several boots and prints, for each phase, the minimum, mean and
+# maximum start time and duration, plus the time to first uplink.
+#
+# The profiles are read from a serial port (requires pyserial), from a
+# console log given on the standard input, or from the host simulator of
+# the node (tests/boot_sim.cpp, built by tests/build.sh), run once per boot
+# with a different seed.
+#
+# A profile is the block of consecutive BOOT lines printed after a
+# "Boot profile" or "Previous boot profile" header, and the profiles are
+# counted in their order of arrival: the boot count of the lines only lives
+# in RAM, and restarts from 0 after each power cycle. "Previous boot"
+# reports are accepted too, so boots that ended before the console was
+# attached are not lost; a previous profile identical to the last profile
+# received is the same boot reported again after a warm reset, and is skipped.
+#
+# Usage:
+#   tools/boot_benchmark.py --port /dev/ttyACM0 --boots 10
+#   tools/boot_benchmark.py < console.log
+#   tools/boot_benchmark.py --simulator /tmp/tp_host_build/boot_sim --boots 100 -- --provisioned
+
+import argparse
+import re
+import subprocess
+import sys
+
+LINE = re.compile(r"^BOOT (\d+) (\w+) start=(\d+) duration=(\d+)")
+HEADER = re.compile(r"^(Previous boot|Boot) profile")
+PHASES = ["console_init", "modem_begin", "sensor_begin", "nvm_read",
+          "nvm_init", "credentials", "nvm_save", "join", "first_tx"]
+
+
+def read_lines(args):
+    if args.simulator is not None:
+        for seed in range(args.boots or 10):
+            result = subprocess.run([args.simulator, "--seed", str(seed)] + args.simulator_args,
+                                    stdout=subprocess.PIPE, universal_newlines=True)
+            yield from result.stdout.splitlines()
+        return
+    if args.port is None:
+        yield from sys.stdin
+        return
+    import serial
+    with serial.Serial(args.port, args.baudrate, timeout=1) as port:
+        while True:
+            yield port.readline().decode("ascii", errors="replace")
+
+
+def read_profiles(lines):
+    """Yields the profiles in their order of arrival, as dicts phase: (start, duration)."""
+    profile = None
+    previous = False
+    last = None
+    for line in lines:
+        line = line.strip()
+        match = LINE.match(line)
+        if match and profile is not None:
+            _, phase, start, duration = match.groups()
+            profile[phase] = (int(start), int(duration))
+            continue
+        if profile and not (previous and profile == last):
+            if not previous:
+                last = profile
+            yield profile
+        profile = None
+        header = HEADER.match(line)
+        if header:
+            profile = {}
+            previous = header.group(1) == "Previous boot"
+    if profile and not (previous and profile == last):
+        yield profile
+
+
+def stats(values):
+    return min(values), sum(values) / len(values), max(values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Aggregates the boot profiles reported by the node.")
+    parser.add_argument("--port", help="serial port of the node console")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--simulator", help="host simulator of the node, run once per boot (tests/boot_sim.cpp)")
+    parser.add_argument("--boots", type=int, default=0,
+                        help="stop after this many complete boots (0: until end of input, 10 simulated boots)")
+    parser.add_argument("simulator_args", nargs="*", help="options of the simulator, after --")
+    args = parser.parse_args()
+
+    complete = []
+    for profile in read_profiles(read_lines(args)):
+        if "first_tx" in profile:
+            complete.append(profile)
+        if args.boots and len(complete) >= args.boots:
+            break
+    if not complete:
+        sys.exit("no complete boot profile received")
+
+    print("%d boots" % len(complete))
+    print("%-14s %26s %26s" % ("phase", "start min/mean/max (ms)", "duration min/mean/max (ms)"))
+    for phase in PHASES:
+        samples = [b[phase] for b in complete if phase in b]
+        if samples:
+            start = stats([s[0] for s in samples])
+            duration = stats([s[1] for s in samples])
+            print("%-14s %8d %8.0f %8d %8d %8.0f %8d" % ((phase,) + start + duration))
+    ttfu = stats([b["first_tx"][0] + b["first_tx"][1] for b in complete])
+    print("%-14s %8d %8.0f %8d" % (("time_to_uplink",) + ttfu))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+#
+# File: decode_uplink.py
+#
+# Description:
+# Decodes the uplink frames of the node (see TP/Uplink.hpp): splits each
+# frame into its records and prints them. The fragments of a message
+# (see TP/Fragment.hpp) are reassembled, the lost fragments being
+# recovered from the parity fragments when possible, and the message is
+# then decoded as a record of its own type. A data record lost among those
+# covered by a parity record (see TP/Redundancy.hpp) is rebuilt.
+#
+# The data records are kept until they are older than those a next parity
+# record may cover: the parity depth K is read from the parity records,
+# and at most K + 1 records are kept (PARITY_MAX_DEPTH + 1 before the first
+# parity record).
+#
+# The node fragments a single message at a time, so only the fragments of
+# the current session are kept: a fragment of another session, or one
+# replacing a different fragment of the same index (the session numbers
+# restarting after a reset), drops them.
+#
+# The frames are read from the standard input, one hexadecimal payload
+# per line, in the order they were received. It is meant to be used as a
+# reference for the decoder of the network server.
+#
+# Usage:
+#   tools/decode_uplink.py < frames.txt
+
+import struct
+import sys
+
+DATA, HEALTH, ALARM, ACK, CONFIG, HISTORY, FRAGMENT, PARITY = range(1, 9)
+ACK_STATUS = {0: "accepted", 1: "rejected", 2: "unknown", 3: "truncated"}
+INVALID = -0x8000
+PARITY_MAX_DEPTH = 255
+
+
+def prbs23(x):
+    b0 = x & 1
+    b1 = (x & 32) >> 5
+    return (x >> 1) + ((b0 ^ b1) << 22)
+
+
+def parity_line(line, count):
+    """Fragments selected by a parity fragment, as fragmentParityLine()."""
+    m = 1 if count & (count - 1) == 0 else 0
+    x = 1 + 1001 * line
+    selected = [False] * count
+    for _ in range(count // 2):
+        r = count
+        while r >= count:
+            x = prbs23(x)
+            r = x % (count + m)
+        selected[r] = True
+    if count == 1:
+        selected[0] = True
+    return selected
+
+
+def recover(count, fragments):
+    """Solves the fragments 1..count by Gaussian elimination over GF(2)."""
+    rows = []
+    for index, data in fragments.items():
+        if index <= count:
+            mask = 1 << (index - 1)
+        else:
+            mask = sum(1 << i for i, s in enumerate(parity_line(index - count, count)) if s)
+        rows.append([mask, bytearray(data)])
+    pivots = []
+    for bit in range(count):
+        pivot = next((r for r in rows if r[0] >> bit & 1 and r not in pivots), None)
+        if pivot is None:
+            return None
+        pivots.append(pivot)
+        for row in rows:
+            if row is not pivot and row[0] >> bit & 1:
+                row[0] ^= pivot[0]
+                row[1] = bytearray(a ^ b for a, b in zip(row[1], pivot[1]))
+    return b"".join(bytes(pivot[1]) for pivot in pivots)
+
+
+def zigzag_varints(data):
+    value, shift = 0, 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield (value >> 1) ^ -(value & 1)
+            value, shift = 0, 0
+
+
+def data_samples(length):
+    """Number of samples of a data record: sequence, 4 flag bits and 4 bytes per sample."""
+    count = 0
+    while 4 + (count + 2) // 2 + 4 * (count + 1) <= length:
+        count += 1
+    return count
+
+
+def to_int16(value):
+    return (value + 0x8000) % 0x10000 - 0x8000
+
+
+def hundredths(value):
+    return None if value == INVALID else value / 100
+
+
+def decode_history(value):
+    sequence, count, used, t, h = struct.unpack(">IBBhh", value[:10])
+    samples = [(t, h)]
+    deltas = list(zigzag_varints(value[10:used]))
+    for dt, dh in zip(deltas[0::2], deltas[1::2]):
+        t, h = to_int16(t + dt), to_int16(h + dh)
+        samples.append((t, h))
+    return ["  sample %d: %s C %s %%" % (sequence + i, hundredths(t), hundredths(h))
+            for i, (t, h) in enumerate(samples[:count])]
+
+
+class Decoder:
+    def __init__(self):
+        self.session = None
+        self.fragments = {}
+        self.reassembled = False
+        self.data = {}
+        self.depth = PARITY_MAX_DEPTH
+
+    def record(self, kind, value):
+        if kind == DATA:
+            sequence = struct.unpack(">I", value[:4])[0]
+            self.data[sequence] = value[4:]
+            for old in sorted(self.data)[:-(self.depth + 1)]:
+                del self.data[old]
+            count = data_samples(len(value))
+            flags = value[4:4 + (count + 1) // 2]
+            lines = ["data"]
+            for i in range(count):
+                raw_t, raw_h = struct.unpack(">HH", value[4 + len(flags) + 4 * i:8 + len(flags) + 4 * i])
+                flag = flags[i // 2] >> (4 * (i % 2))
+                t = "%.2f" % (-45 + 175 * raw_t / 65535) if flag & 1 else "invalid"
+                h = "%.2f" % (100 * raw_h / 65535) if flag & 2 else "invalid"
+                lines.append("  sample %d: %s C %s %%%s" % (sequence + i, t, h, " (heated)" if flag & 4 else ""))
+            return lines
+        if kind == HEALTH:
+            line = ("health v%d success=%d%% margin=%ddB gateways=%d errors=%d uptime=%ds"
+                    % (value[0], value[1], value[2], value[3],
+                       struct.unpack(">H", value[4:6])[0], struct.unpack(">I", value[9:13])[0]))
+            if value[0] >= 3:
+                line += " heater_pulses=%d heater_energy=%dJ" % struct.unpack(">HH", value[23:27])
+            if value[0] >= 4:
+                line += " sensor_failures=%d bus_clears=%d sensor_resets=%d" % struct.unpack(">HBB", value[27:31])
+            return [line]
+        if kind == ALARM:
+            state, t, dew = struct.unpack(">Bhh", value[1:6])
+            return ["alarm 0x%02x %s temperature=%.2f C dew_point=%.2f C"
+                    % (value[0], "raised" if state else "cleared", t / 100, dew / 100)]
+        if kind == ACK:
+            return ["ack command 0x%02x %s" % (value[i], ACK_STATUS.get(value[i + 1], value[i + 1]))
+                    for i in range(0, len(value) - 1, 2)]
+        if kind == CONFIG:
+            return ["config digest 0x%04x" % struct.unpack(">H", value)[0]]
+        if kind == HISTORY:
+            return ["history"] + decode_history(value)
+        if kind == FRAGMENT:
+            return self.fragment(value)
+        if kind == PARITY:
+            return self.parity(value)
+        return ["record type %d: %s" % (kind, value.hex())]
+
+    def fragment(self, value):
+        session, kind, count, index, length = struct.unpack(">BBBBH", value[:6])
+        key = (session, kind, count, length)
+        if key != self.session or self.fragments.get(index, value[6:]) != value[6:]:
+            self.session = key
+            self.fragments = {}
+            self.reassembled = False
+        self.fragments[index] = value[6:]
+        lines = ["fragment %d/%d of session %d" % (index, count, session)]
+        if not self.reassembled:
+            message = recover(count, self.fragments)
+            if message is not None:
+                self.reassembled = True
+                lines += self.record(kind, message[:length])
+        return lines
+
+    def parity(self, value):
+        first, count = struct.unpack(">IB", value[:5])
+        self.depth = count
+        for old in [s for s in self.data if s < first]:
+            del self.data[old]
+        samples = value[5:]
+        batch = data_samples(len(samples) + 4)
+        covered = [first + i * batch for i in range(count)]
+        missing = [s for s in covered if s not in self.data]
+        lines = ["parity of %d records from sample %d" % (count, first)]
+        if len(missing) == 1:
+            rebuilt = bytearray(samples)
+            for sequence in covered:
+                if sequence != missing[0]:
+                    rebuilt = bytearray(a ^ b for a, b in zip(rebuilt, self.data[sequence]))
+            record = self.record(DATA, struct.pack(">I", missing[0]) + bytes(rebuilt))
+            lines += ["recovered " + record[0]] + record[1:]
+        return lines
+
+    def frame(self, payload):
+        lines = []
+        i = 0
+        while i + 2 <= len(payload):
+            kind, length = payload[i], payload[i + 1]
+            lines += self.record(kind, payload[i + 2:i + 2 + length])
+            i += 2 + length
+        return lines
+
+
+def main():
+    decoder = Decoder()
+    for line in sys.stdin:
+        line = line.strip()
+        if line:
+            print("\n".join(decoder.frame(bytes.fromhex(line))))
+
+
+if __name__ == "__main__":
+    main()
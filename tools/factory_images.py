@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#
+# File: factory_images.py
+#
+# Description:
+# Generates one firmware image per device from a factory image of the
+# node (built with -DNODE_CONFIG=FactoryProvisioningConfig, see
+# TP/Config.hpp): the FactoryCredentials record of the image (see
+# TP/Driver_Credentials.hpp) is located by its marker and its template
+# CRC, the complement of the valid one, and the credentials of each device
+# of a CSV manifest and their CRC are written into a copy. The devices
+# boot and join without the console or the NVM of the modem; the factory
+# image itself is rejected by the firmware, which falls back to the console.
+#
+# The factory image is either given as a .bin file, or built from the
+# sketch with arduino-cli (--build). The images are written to the output
+# directory as <dev_eui>.bin, to be flashed at the offset of the sketch.
+#
+# The manifest has a header line:
+#   dev_eui,app_eui,app_key
+#   0011223344556677,70B3D57ED0000000,000102030405060708090A0B0C0D0E0F
+#
+# Usage:
+#   tools/factory_images.py manifest.csv --image TP.ino.bin
+#   tools/factory_images.py manifest.csv --build TP --output images
+
+import argparse
+import binascii
+import csv
+import glob
+import os
+import re
+import struct
+import subprocess
+import sys
+
+MAGIC = struct.pack("<I", 0x44524346)
+# Fields of FactoryCredentials: name, offset, length without terminator
+FIELDS = [("dev_eui", 6, 16), ("app_eui", 23, 16), ("app_key", 40, 32)]
+CRC_OFFSET = 4
+RECORD_SIZE = 73
+NOINIT_SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "noinit.ld")
+
+
+def credentials_crc(values):
+    return binascii.crc_hqx("".join(values).encode("ascii"), 0xFFFF)
+
+
+def parse_record(image, offset, template=False):
+    """Credentials of the record at offset, or None if it is not a valid record.
+
+    A template record, as built, holds the complement of the CRC of its
+    values, so that the firmware rejects it until it is personalized.
+    """
+    record = image[offset:offset + RECORD_SIZE]
+    if len(record) < RECORD_SIZE or record[:4] != MAGIC:
+        return None
+    values = []
+    for _, start, length in FIELDS:
+        text = record[start:start + length]
+        if record[start + length] != 0 or not re.fullmatch(rb"[0-9A-Fa-f]+", text):
+            return None
+        values.append(text.decode("ascii"))
+    crc = struct.unpack("<H", record[CRC_OFFSET:CRC_OFFSET + 2])[0]
+    expected = credentials_crc(values) ^ 0xFFFF if template else credentials_crc(values)
+    return values if crc == expected else None
+
+
+def find_record(image):
+    offsets = [m.start() for m in re.finditer(re.escape(MAGIC), image) if parse_record(image, m.start(), template=True)]
+    if len(offsets) != 1:
+        sys.exit("%d factory credentials templates found in the image, expected 1: "
+                 "build it with -DNODE_CONFIG=FactoryProvisioningConfig" % len(offsets))
+    return offsets[0]
+
+
+def personalize(image, offset, device):
+    values = []
+    for name, _, length in FIELDS:
+        value = device[name].strip().upper()
+        if not re.fullmatch(r"[0-9A-F]{%d}" % length, value):
+            raise ValueError("invalid %s %r" % (name, device[name]))
+        values.append(value)
+    patched = bytearray(image)
+    struct.pack_into("<H", patched, offset + CRC_OFFSET, credentials_crc(values))
+    for (_, start, length), value in zip(FIELDS, values):
+        patched[offset + start:offset + start + length] = value.encode("ascii")
+    assert parse_record(bytes(patched), offset) == values
+    return bytes(patched)
+
+
+def build(sketch, fqbn, output):
+    build_dir = os.path.join(output, "build")
+    subprocess.run(["arduino-cli", "compile", "--fqbn", fqbn, "--output-dir", build_dir,
+                    "--build-property", "compiler.cpp.extra_flags=-DNODE_CONFIG=FactoryProvisioningConfig",
+                    "--build-property", "compiler.c.elf.extra_flags=-T" + NOINIT_SCRIPT,
+                    sketch], check=True)
+    images = [f for f in glob.glob(os.path.join(build_dir, "*.bin")) if "bootloader" not in f]
+    if len(images) != 1:
+        sys.exit("cannot find the image built in %s" % build_dir)
+    return images[0]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generates one firmware image per device of a manifest.")
+    parser.add_argument("manifest", help="CSV file: dev_eui,app_eui,app_key")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--image", help="factory image (.bin)")
+    source.add_argument("--build", metavar="SKETCH", help="build the factory image of this sketch with arduino-cli")
+    parser.add_argument("--fqbn", default="arduino:samd:mkrwan1310")
+    parser.add_argument("--output", default="factory_images", help="directory of the generated images")
+    args = parser.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+    image_path = args.image or build(args.build, args.fqbn, args.output)
+    with open(image_path, "rb") as image_file:
+        image = image_file.read()
+    offset = find_record(image)
+
+    with open(args.manifest, newline="") as manifest:
+        devices = list(csv.DictReader(manifest))
+    for line, device in enumerate(devices, start=2):
+        try:
+            patched = personalize(image, offset, device)
+        except (KeyError, ValueError) as error:
+            sys.exit("%s:%d: %s" % (args.manifest, line, error))
+        with open(os.path.join(args.output, "%s.bin" % device["dev_eui"].strip().upper()), "wb") as output:
+            output.write(patched)
+    print("%d images written to %s (record at offset 0x%x)" % (len(devices), args.output, offset))
+
+
+if __name__ == "__main__":
+    main()
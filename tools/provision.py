@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# File: provision.py
+#
+# Description:
+# Provisions the LoRaWAN credentials of many nodes in parallel, one serial
+# port per node (requires pyserial). Each node receives a single AT+P
+# message holding its DevEUI, AppEUI and AppKey protected by a CRC-16/CCITT
+# (see TP/Driver_Credentials.hpp), and answers once with "+OK <digest>" when
+# the credentials are saved, or "+ERR <reason>". A message corrupted on the
+# link is sent again.
+#
+# The nodes must be waiting for their credentials, i.e. freshly flashed
+# (or with a new MAGIC_NUMBER). The message can be sent as soon as the port
+# is open: the node reads it when it reaches the credentials step of its boot.
+#
+# The boards are listed in a CSV file with a header line:
+#   port,dev_eui,app_eui,app_key
+#   /dev/ttyACM0,0011223344556677,70B3D57ED0000000,000102030405060708090A0B0C0D0E0F
+#
+# Usage:
+#   tools/provision.py boards.csv
+#   tools/provision.py boards.csv --digest 1A2B --timeout 60
+
+import argparse
+import binascii
+import csv
+import re
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+CREDENTIALS = [("dev_eui", 16), ("app_eui", 16), ("app_key", 32)]
+RESPONSE = re.compile(r"^\+(OK|ERR) ?(\w*)")
+
+
+def provisioning_message(board):
+    """AT+P message of a board, as checked by provision() in the firmware."""
+    for field, length in CREDENTIALS:
+        if not re.fullmatch(r"[0-9A-Fa-f]{%d}" % length, board[field]):
+            raise ValueError("%s: invalid %s %r" % (board["port"], field, board[field]))
+    body = ",".join(board[field].upper() for field, _ in CREDENTIALS)
+    return "AT+P=%s,%04X\r\n" % (body, binascii.crc_hqx(body.encode("ascii"), 0xFFFF))
+
+
+def provision(board, args):
+    """Provisions one board, returns (port, success, detail)."""
+    import serial
+    message = provisioning_message(board).encode("ascii")
+    try:
+        with serial.Serial(board["port"], args.baudrate, timeout=args.timeout) as port:
+            for _ in range(args.attempts):
+                port.write(message)
+                while True:
+                    line = port.readline().decode("ascii", errors="replace").strip()
+                    if not line:
+                        return board["port"], False, "no response"
+                    match = RESPONSE.match(line)
+                    if match:
+                        break
+                status, detail = match.groups()
+                if status == "OK":
+                    if args.digest and detail.upper() != args.digest.upper():
+                        return board["port"], False, "configuration digest %s, expected %s" % (detail, args.digest)
+                    return board["port"], True, "digest %s" % detail
+                if detail != "CRC":
+                    return board["port"], False, "rejected: %s" % detail
+            return board["port"], False, "rejected: CRC after %d attempts" % args.attempts
+    except serial.SerialException as error:
+        return board["port"], False, str(error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Provisions the credentials of many nodes in parallel.")
+    parser.add_argument("boards", help="CSV file: port,dev_eui,app_eui,app_key")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=30,
+                        help="seconds to wait for the response of a node")
+    parser.add_argument("--attempts", type=int, default=3,
+                        help="sendings of a message rejected for its CRC")
+    parser.add_argument("--digest", help="expected configuration digest of the firmware (4 hex digits)")
+    args = parser.parse_args()
+
+    with open(args.boards, newline="") as boards_file:
+        boards = list(csv.DictReader(boards_file))
+    if not boards:
+        sys.exit("no board in %s" % args.boards)
+    try:
+        for board in boards:
+            provisioning_message(board)
+    except ValueError as error:
+        sys.exit(str(error))
+
+    with ThreadPoolExecutor(max_workers=len(boards)) as pool:
+        results = list(pool.map(lambda board: provision(board, args), boards))
+
+    failures = 0
+    for port, success, detail in results:
+        print("%-20s %-4s %s" % (port, "OK" if success else "FAIL", detail))
+        failures += not success
+    print("%d provisioned, %d failed" % (len(results) - failures, failures))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# File: provision_bench.py
+#
+# Description:
+# Benchmarks the provisioning of a node on the host: the firmware itself
+# (TP.ino and the TP sources, with Driver_Credentials and Console) runs on
+# the simulated board of tests/host, against a simulated modem UART and
+# USB console with timed delivery (tests/boot_sim.cpp, built by
+# tests/build.sh). Each flow is booted --runs times with different seeds,
+# and the boot profiles printed by the firmware (see TP/Profiler.cpp) give
+# the time of each provisioning phase:
+# - interactive: AT+D, AT+A, AT+K and AT+S, each sent once the previous one
+#   is answered (boot_sim --flow interactive)
+# - bulk: a single AT+P message (tools/provision.py, boot_sim --flow bulk)
+# - factory: credentials read from the image personalized by
+#   tools/factory_images.py (boot_sim_factory)
+#
+# The phases are the ones of tools/boot_benchmark.py, from modem_begin to
+# nvm_save, and the total is the time from the reset until the node is
+# provisioned. The modem latencies, the answers it drops and the failures
+# of modem.begin() are passed to the simulator, so that the retries and
+# timeout paths of the firmware are timed too. The boots that do not reach
+# their first uplink within the simulated time limit (--limit-s) are counted
+# as failed: a board whose modem does not start at boot halts, and has to
+# be reset by the operator.
+# The line rate is given for --ports boards provisioned in parallel, each
+# also taking --handling-s seconds to plug and flash.
+#
+# Usage:
+#   tests/build.sh && tools/provision_bench.py
+#   tools/provision_bench.py --runs 200 --nvm-write-ms 8 --drop-rate 0.05 --ports 16 --handling-s 20
+
+import argparse
+import os
+import subprocess
+import sys
+
+from boot_benchmark import read_profiles
+
+STEPS = ["modem_begin", "nvm_read", "nvm_init", "credentials", "nvm_save"]
+FLOWS = [("interactive", "boot_sim", ["--flow", "interactive"]),
+         ("bulk", "boot_sim", ["--flow", "bulk"]),
+         ("factory", "boot_sim_factory", [])]
+
+
+def run(path, seed, options):
+    """Boot profile of one simulated boot, or None if it failed."""
+    result = subprocess.run([path, "--seed", str(seed)] + options,
+                            stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, universal_newlines=True)
+    profiles = [p for p in read_profiles(result.stdout.splitlines()) if "first_tx" in p]
+    return profiles[0] if result.returncode == 0 and profiles else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks the provisioning of the firmware on the host simulator.")
+    parser.add_argument("--build-dir", default=os.environ.get("BUILD_DIR", "/tmp/tp_host_build"),
+                        help="directory of the programs built by tests/build.sh")
+    parser.add_argument("--runs", type=int, default=50, help="simulated boards per flow")
+    parser.add_argument("--modem-begin-ms", type=int, help="reset and band configuration of modem.begin()")
+    parser.add_argument("--modem-begin-success", type=float, help="probability that modem.begin() succeeds")
+    parser.add_argument("--nvm-read-ms", type=int, help="modem processing time of an NVM read")
+    parser.add_argument("--nvm-write-ms", type=int, help="modem processing time of an NVM write")
+    parser.add_argument("--command-ms", type=int, help="processing time of another command")
+    parser.add_argument("--usb-latency-us", type=int, help="latency of a USB console transfer")
+    parser.add_argument("--drop-rate", type=float, help="probability that the modem leaves a command unanswered")
+    parser.add_argument("--jitter", type=float, help="relative jitter of the latencies")
+    parser.add_argument("--limit-s", type=float, default=3600, help="simulated time after which a boot has failed")
+    parser.add_argument("--ports", type=int, default=1, help="boards provisioned in parallel")
+    parser.add_argument("--handling-s", type=float, default=0,
+                        help="time per board outside of the provisioning (plugging, flashing), for the boards/hour")
+    args = parser.parse_args()
+
+    options = ["--limit-s", str(args.limit_s)]
+    for name in ["modem_begin_ms", "modem_begin_success", "nvm_read_ms", "nvm_write_ms",
+                 "command_ms", "usb_latency_us", "drop_rate", "jitter"]:
+        if getattr(args, name) is not None:
+            options += ["--" + name.replace("_", "-"), str(getattr(args, name))]
+
+    print("%-12s" % "flow" + "".join("%14s" % s for s in STEPS) + "%13s %7s %12s" % ("total", "failed", "boards/hour"))
+    for flow, program, flow_options in FLOWS:
+        path = os.path.join(args.build_dir, program)
+        if not os.path.exists(path):
+            sys.exit("%s not found: build it with tests/build.sh" % path)
+        profiles = [run(path, seed, options + flow_options) for seed in range(args.runs)]
+        complete = [p for p in profiles if p is not None]
+        if not complete:
+            print("%-12s no complete boot" % flow)
+            continue
+        means = [sum(p[s][1] for p in complete if s in p) / len(complete) for s in STEPS]
+        # Time from the reset until the last provisioning phase ends
+        total = sum(max(p[s][0] + p[s][1] for s in STEPS if s in p) for p in complete) / len(complete)
+        rate = args.ports * 3600000.0 / (total + args.handling_s * 1000)
+        print("%-12s" % flow + "".join("%11.1f ms" % m for m in means)
+              + "%10.1f ms %7d %12.0f" % (total, len(profiles) - len(complete), rate))
+
+
+if __name__ == "__main__":
+    main()
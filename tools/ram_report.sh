@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# File: ram_report.sh
+#
+# Description:
+# Builds the TP sketch for the MKR WAN 1310 with arduino-cli and prints
+# the static RAM budget of the firmware:
+# - .data and .bss usage of every module (one line per object file),
+# - the stack frame of every function, largest first, as reported by
+#   GCC's -fstack-usage ("dynamic" frames are flagged),
+# - the presence of heap allocation symbols (malloc, String) linked in,
+# - the placement of the .noinit section (tools/noinit.ld), which must lie
+#   between the end of .bss and the start of the heap.
+#
+# Usage: tools/ram_report.sh [sketch_dir] [fqbn]
+#
+# Note:
+# arduino-cli and the Arduino SAMD core must be installed. The size and
+# nm tools of the SAMD toolchain are looked up in the PATH first, then
+# in the arduino-cli data directory.
+
+set -e
+
+SKETCH_DIR=${1:-"$(dirname "$0")/../TP"}
+FQBN=${2:-arduino:samd:mkrwan1310}
+BUILD_DIR=${BUILD_DIR:-/tmp/tp_ram_report}
+
+find_tool()
+{
+  if command -v "arm-none-eabi-$1" >/dev/null 2>&1; then
+    command -v "arm-none-eabi-$1"
+  else
+    find "$HOME/.arduino15/packages/arduino/tools" -name "arm-none-eabi-$1" -type f 2>/dev/null | head -n 1
+  fi
+}
+
+arduino-cli compile --fqbn "$FQBN" --build-path "$BUILD_DIR" \
+  --build-property "compiler.cpp.extra_flags=-fstack-usage" \
+  --build-property "compiler.c.extra_flags=-fstack-usage" \
+  --build-property "compiler.c.elf.extra_flags=-T$(cd "$(dirname "$0")" && pwd)/noinit.ld" \
+  "$SKETCH_DIR" >/dev/null
+
+SIZE=$(find_tool size)
+NM=$(find_tool nm)
+READELF=$(find_tool readelf)
+
+echo "== Static RAM per sketch module (bytes)"
+printf "%-32s %8s %8s\n" "module" ".data" ".bss"
+for obj in "$BUILD_DIR"/sketch/*.o; do
+  "$SIZE" -A "$obj" | awk -v name="$(basename "$obj" .o)" '
+    $1 ~ /^\.data/ { data += $2 }
+    $1 ~ /^\.bss/  { bss += $2 }
+    END { printf "%-32s %8d %8d\n", name, data, bss }'
+done
+
+echo
+echo "== Whole firmware"
+"$SIZE" "$BUILD_DIR"/*.elf
+
+echo
+echo "== Largest stack frames (bytes)"
+cat "$BUILD_DIR"/sketch/*.su 2>/dev/null | sort -t "$(printf '\t')" -k 2 -n -r | head -n 20
+
+echo
+echo "== Heap allocation symbols linked in"
+"$NM" -C "$BUILD_DIR"/*.elf | grep -E " (malloc|_malloc_r|realloc|String::String)" || echo "none"
+
+echo
+echo "== .noinit placement"
+"$READELF" -S -W "$BUILD_DIR"/*.elf | grep -E " \.(bss|noinit|heap) "
+"$NM" "$BUILD_DIR"/*.elf | awk '
+  $3 == "__bss_end__" { bss_end = $1 }
+  $3 == "__noinit_start__" { start = $1 }
+  $3 == "__noinit_end__" { stop = $1 }
+  $3 == "__end__" { heap = $1 }
+  END {
+    if (start == "") { print "FAIL: no .noinit output section, link with tools/noinit.ld"; exit 1 }
+    if (start < bss_end || stop > heap) { print "FAIL: .noinit overlaps .bss or the heap"; exit 1 }
+    print "OK: .noinit from 0x" start " to 0x" stop ", not cleared at reset"
+  }'